@@ -86,6 +86,12 @@ ifneq "$(strip $(DEBUG_AHCI) $(DEBUG_ALL))" ""
 KERN_DEBUG_FLAGS	+= -DDEBUG_AHCI
 endif
 
+# If set, link a freshly made file system image into the kernel and use
+# the RAM disk holding it as the root device
+ifneq "$(strip $(RAMDISK))" ""
+KERN_DEBUG_FLAGS	+= -DRAMDISK
+endif
+
 # If set, enable debugging processes
 ifneq "$(strip $(DEBUG_PROC) $(DEBUG_ALL))" ""
 KERN_DEBUG_FLAGS	+= -DDEBUG_PROC -DDEBUG_MSG
@@ -0,0 +1,72 @@
+#include <lib/x86.h>
+#include <lib/spinlock.h>
+#include <thread/PTCBIntro/export.h>
+#include <thread/PCurID/export.h>
+#include <thread/PThread/export.h>
+
+#include "cv.h"
+
+void cv_init(cv_t *cv)
+{
+    cv->head = NUM_IDS;
+    cv->tail = NUM_IDS;
+}
+
+static void cv_enqueue(cv_t *cv, unsigned int pid)
+{
+    tcb_set_prev(pid, cv->tail);
+    tcb_set_next(pid, NUM_IDS);
+    if (cv->tail == NUM_IDS)
+        cv->head = pid;
+    else
+        tcb_set_next(cv->tail, pid);
+    cv->tail = pid;
+}
+
+static unsigned int cv_dequeue(cv_t *cv)
+{
+    unsigned int pid = cv->head;
+
+    if (pid != NUM_IDS) {
+        cv->head = tcb_get_next(pid);
+        if (cv->head == NUM_IDS)
+            cv->tail = NUM_IDS;
+        else
+            tcb_set_prev(cv->head, NUM_IDS);
+        tcb_set_prev(pid, NUM_IDS);
+        tcb_set_next(pid, NUM_IDS);
+    }
+    return pid;
+}
+
+void cv_wait(cv_t *cv, spinlock_t *lock)
+{
+    uint32_t intr = lock->intr;
+
+    cv_enqueue(cv, get_curid());
+
+    // Leave interrupts off across the release, so no signal can come
+    // between it and the switch; the next thread turns them back on.
+    lock->intr = 0;
+    spinlock_release(lock);
+    thread_suspend();
+
+    spinlock_acquire(lock);
+    lock->intr = intr;
+}
+
+void cv_signal(cv_t *cv)
+{
+    unsigned int pid;
+
+    if ((pid = cv_dequeue(cv)) != NUM_IDS)
+        thread_ready(pid);
+}
+
+void cv_broadcast(cv_t *cv)
+{
+    unsigned int pid;
+
+    while ((pid = cv_dequeue(cv)) != NUM_IDS)
+        thread_ready(pid);
+}
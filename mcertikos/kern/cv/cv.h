@@ -0,0 +1,34 @@
+#ifndef _KERN_CV_H_
+#define _KERN_CV_H_
+
+#ifdef _KERN_
+
+#include <lib/spinlock.h>
+
+/**
+ * A condition variable: a queue of sleeping threads, linked through
+ * their TCBs like the thread queues in TQueuePool. NUM_IDS stands for
+ * no thread.
+ */
+typedef struct {
+    unsigned int head;
+    unsigned int tail;
+} cv_t;
+
+void cv_init(cv_t *cv);
+
+/**
+ * Atomically release lock and sleep on cv; reacquire lock once woken.
+ * The caller must hold lock and recheck its condition after waking.
+ */
+void cv_wait(cv_t *cv, spinlock_t *lock);
+
+// Wake the thread that has waited on cv the longest.
+void cv_signal(cv_t *cv);
+
+// Wake every thread waiting on cv.
+void cv_broadcast(cv_t *cv);
+
+#endif  /* _KERN_ */
+
+#endif  /* !_KERN_CV_H_ */
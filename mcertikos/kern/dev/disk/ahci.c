@@ -0,0 +1,480 @@
+/*
+ * Driver for AHCI SATA host controllers, such as QEMU's ich9-ahci.
+ *
+ * Every disk port has a command list of up to 32 slots. A request
+ * takes a free slot, builds a READ/WRITE FPDMA QUEUED command whose
+ * PRDs point at the data of its bufs, and issues it by setting its bit
+ * in PxSACT and PxCI. The disk may complete queued commands in any
+ * order; ahci_intr() finds the slots whose bits have cleared, marks
+ * their bufs done and wakes the owners. NCQ is used only if both the
+ * controller and the disk's IDENTIFY data say it is supported, with at
+ * most as many slots as the disk's queue depth; otherwise commands are
+ * READ/WRITE DMA EXT, which the controller runs one by one.
+ *
+ * On a task file error the port is stopped, its error state cleared
+ * and the port restarted; every command still outstanding on it fails
+ * with B_ERROR.
+ *
+ * Build with DEBUG_AHCI=1 to trace commands.
+ */
+
+#include <lib/debug.h>
+#include <lib/gcc.h>
+#include <lib/string.h>
+#include <lib/types.h>
+#include <lib/x86.h>
+#include <lib/spinlock.h>
+#include <lib/buf.h>
+#include <thread/PThread/export.h>
+#include <dev/pci.h>
+
+#include "disk.h"
+#include "ahci.h"
+
+#ifdef DEBUG_AHCI
+#define AHCI_DEBUG(fmt, ...) KERN_DEBUG("[AHCI] " fmt, ##__VA_ARGS__)
+#else
+#define AHCI_DEBUG(fmt, ...) do {} while (0)
+#endif
+
+#define PCI_PROGIF_AHCI 0x01
+
+// HBA registers
+#define HBA_CAP  0x00
+#define HBA_GHC  0x04
+#define HBA_IS   0x08
+#define HBA_PI   0x0c
+
+#define HBA_CAP_SNCQ  (1u << 30)
+#define HBA_CAP_SCLO  (1u << 24)
+#define HBA_CAP_NCS(cap) ((((cap) >> 8) & 0x1f) + 1)
+
+#define HBA_GHC_AE (1u << 31)
+#define HBA_GHC_IE (1u << 1)
+
+// Port registers, relative to 0x100 + 0x80 * port
+#define PORT_CLB  0x00
+#define PORT_CLBU 0x04
+#define PORT_FB   0x08
+#define PORT_FBU  0x0c
+#define PORT_IS   0x10
+#define PORT_IE   0x14
+#define PORT_CMD  0x18
+#define PORT_TFD  0x20
+#define PORT_SIG  0x24
+#define PORT_SSTS 0x28
+#define PORT_SERR 0x30
+#define PORT_SACT 0x34
+#define PORT_CI   0x38
+
+#define PORT_CMD_ST  (1u << 0)
+#define PORT_CMD_CLO (1u << 3)
+#define PORT_CMD_FRE (1u << 4)
+#define PORT_CMD_FR  (1u << 14)
+#define PORT_CMD_CR  (1u << 15)
+
+#define PORT_IS_TFES (1u << 30)  // task file error
+
+#define PORT_TFD_ERR 0x01
+#define PORT_TFD_DRQ 0x08
+#define PORT_TFD_BSY 0x80
+
+#define SATA_SIG_ATA 0x00000101
+
+#define FIS_TYPE_REG_H2D 0x27
+
+#define ATA_CMD_READ_DMA_EXT      0x25
+#define ATA_CMD_WRITE_DMA_EXT     0x35
+#define ATA_CMD_READ_FPDMA_QUEUED  0x60
+#define ATA_CMD_WRITE_FPDMA_QUEUED 0x61
+#define ATA_CMD_IDENTIFY           0xec
+
+// Words of the IDENTIFY DEVICE data
+#define ATA_ID_QUEUE_DEPTH 75  // bits 0-4: queue depth - 1
+#define ATA_ID_SATA_CAP    76
+#define ATA_ID_SATA_CAP_NCQ (1u << 8)
+
+#define NSLOT     32
+#define NAHCIDISK 2  // disks (ports) we drive; b->dev picks one
+
+struct ahci_cmd_header {
+    uint16_t flags;  // FIS length in dwords, W (bit 6)
+    uint16_t prdtl;  // PRD table entries
+    volatile uint32_t prdbc;
+    uint32_t ctba;
+    uint32_t ctbau;
+    uint32_t reserved[4];
+};
+
+#define CMD_HDR_WRITE (1 << 6)
+
+struct ahci_prd {
+    uint32_t dba;
+    uint32_t dbau;
+    uint32_t reserved;
+    uint32_t dbc;  // byte count - 1
+};
+
+struct ahci_cmd_table {
+    uint8_t cfis[64];
+    uint8_t acmd[16];
+    uint8_t reserved[48];
+    struct ahci_prd prd[NDISKMERGE];
+} gcc_aligned(128);
+
+struct ahci_port_mem {
+    struct ahci_cmd_header cl[NSLOT] gcc_aligned(1024);
+    uint8_t fis[256] gcc_aligned(256);
+    struct ahci_cmd_table ct[NSLOT];
+};
+
+struct ahci_disk {
+    uint32_t port;    // register base of the port
+    uint32_t active;  // slots issued and not yet completed
+    bool ncq;         // both the HBA and the disk do NCQ
+    int nslot;        // slots in use: at most the disk's queue depth
+    struct buf **bufs[NSLOT];  // the bufs of each slot's command
+    int nbufs[NSLOT];
+};
+
+static struct ahci_port_mem port_mem[NAHCIDISK] gcc_aligned(1024);
+static uint16_t ident[256];  // IDENTIFY DEVICE data, during ahci_init()
+
+static struct {
+    spinlock_t lock;
+    uint32_t abar;  // HBA registers; MMIO is identity-mapped
+    uint32_t cap;
+    bool ncq;       // the HBA does NCQ
+    int nslot;      // command slots per port
+    int ndisk;
+    struct ahci_disk disk[NAHCIDISK];
+} ahci;
+
+static uint32_t hba_read(uint32_t reg)
+{
+    return *(volatile uint32_t *) (ahci.abar + reg);
+}
+
+static void hba_write(uint32_t reg, uint32_t v)
+{
+    *(volatile uint32_t *) (ahci.abar + reg) = v;
+}
+
+static uint32_t port_read(struct ahci_disk *d, uint32_t reg)
+{
+    return hba_read(d->port + reg);
+}
+
+static void port_write(struct ahci_disk *d, uint32_t reg, uint32_t v)
+{
+    hba_write(d->port + reg, v);
+}
+
+/**
+ * Point the port at our command list and FIS area and start it.
+ */
+static void ahci_port_start(struct ahci_disk *d, struct ahci_port_mem *m)
+{
+    int i;
+
+    // Stop the command engine and FIS receive before moving them.
+    port_write(d, PORT_CMD, port_read(d, PORT_CMD) & ~(PORT_CMD_ST | PORT_CMD_FRE));
+    while (port_read(d, PORT_CMD) & (PORT_CMD_CR | PORT_CMD_FR))
+        /* do nothing */ ;
+
+    memset(m, 0, sizeof(*m));
+    for (i = 0; i < NSLOT; i++) {
+        m->cl[i].ctba = (uintptr_t) &m->ct[i];
+        m->cl[i].ctbau = 0;
+    }
+    port_write(d, PORT_CLB, (uintptr_t) m->cl);
+    port_write(d, PORT_CLBU, 0);
+    port_write(d, PORT_FB, (uintptr_t) m->fis);
+    port_write(d, PORT_FBU, 0);
+
+    port_write(d, PORT_SERR, 0xffffffff);
+    port_write(d, PORT_IS, 0xffffffff);
+    port_write(d, PORT_IE, 0xffffffff);
+
+    port_write(d, PORT_CMD, port_read(d, PORT_CMD) | PORT_CMD_FRE);
+    port_write(d, PORT_CMD, port_read(d, PORT_CMD) | PORT_CMD_ST);
+}
+
+/**
+ * Bring port d back after a task file error: stop the command engine,
+ * clear the error and interrupt status, and start it again. The HBA
+ * drops every command that was issued; the caller fails them.
+ */
+static void ahci_port_recover(struct ahci_disk *d)
+{
+    port_write(d, PORT_CMD, port_read(d, PORT_CMD) & ~PORT_CMD_ST);
+    while (port_read(d, PORT_CMD) & PORT_CMD_CR)
+        /* do nothing */ ;
+
+    port_write(d, PORT_SERR, 0xffffffff);
+    port_write(d, PORT_IS, 0xffffffff);
+
+    // A disk still busy would keep the port from starting.
+    if ((port_read(d, PORT_TFD) & (PORT_TFD_BSY | PORT_TFD_DRQ))
+        && (ahci.cap & HBA_CAP_SCLO)) {
+        port_write(d, PORT_CMD, port_read(d, PORT_CMD) | PORT_CMD_CLO);
+        while (port_read(d, PORT_CMD) & PORT_CMD_CLO)
+            /* do nothing */ ;
+    }
+
+    port_write(d, PORT_CMD, port_read(d, PORT_CMD) | PORT_CMD_ST);
+}
+
+/**
+ * Run IDENTIFY DEVICE on the started port d in slot 0, polling for
+ * completion, and leave the data in ident. Return -1 on an error.
+ */
+static int ahci_identify(struct ahci_disk *d, struct ahci_port_mem *m)
+{
+    struct ahci_cmd_header *h = &m->cl[0];
+    struct ahci_cmd_table *t = &m->ct[0];
+    uint32_t is;
+
+    memset(t, 0, sizeof(*t));
+    t->prd[0].dba = (uintptr_t) ident;
+    t->prd[0].dbau = 0;
+    t->prd[0].dbc = sizeof(ident) - 1;
+    t->cfis[0] = FIS_TYPE_REG_H2D;
+    t->cfis[1] = 0x80;  // command, not control
+    t->cfis[2] = ATA_CMD_IDENTIFY;
+    h->flags = 5;  // 5-dword H2D FIS; the data comes from the disk
+    h->prdtl = 1;
+    h->prdbc = 0;
+
+    port_write(d, PORT_CI, 1);
+    while ((port_read(d, PORT_CI) & 1)
+           && !(port_read(d, PORT_IS) & PORT_IS_TFES))
+        /* do nothing */ ;
+    is = port_read(d, PORT_IS);
+    port_write(d, PORT_IS, is);
+    if (is & PORT_IS_TFES) {
+        ahci_port_recover(d);
+        return -1;
+    }
+    return 0;
+}
+
+int ahci_init(void)
+{
+    struct pci_func f;
+    uint32_t cap, pi, ssts;
+    int i;
+
+    if (pci_find_class(PCI_CLASS_STORAGE, PCI_SUBCLASS_SATA, &f) != 0
+        || f.progif != PCI_PROGIF_AHCI)
+        return -1;
+    pci_enable(&f);
+
+    spinlock_init(&ahci.lock);
+    ahci.abar = f.bar[5] & ~0xf;
+    hba_write(HBA_GHC, hba_read(HBA_GHC) | HBA_GHC_AE);
+
+    cap = hba_read(HBA_CAP);
+    ahci.cap = cap;
+    ahci.ncq = (cap & HBA_CAP_SNCQ) != 0;
+    ahci.nslot = HBA_CAP_NCS(cap);
+
+    // Drive the first NAHCIDISK ports with an ATA disk attached,
+    // in port order: disk 0 is the boot disk, disk 1 the file system.
+    pi = hba_read(HBA_PI);
+    for (i = 0; i < 32 && ahci.ndisk < NAHCIDISK; i++) {
+        struct ahci_disk *d = &ahci.disk[ahci.ndisk];
+
+        if (!(pi & (1u << i)))
+            continue;
+        d->port = 0x100 + 0x80 * i;
+        ssts = port_read(d, PORT_SSTS);
+        if ((ssts & 0xf) != 3 || ((ssts >> 8) & 0xf) != 1)
+            continue;  // no device, or not active
+        if (port_read(d, PORT_SIG) != SATA_SIG_ATA)
+            continue;
+        ahci_port_start(d, &port_mem[ahci.ndisk]);
+
+        // The HBA doing NCQ says nothing about the disk.
+        d->ncq = FALSE;
+        d->nslot = ahci.nslot;
+        if (ahci_identify(d, &port_mem[ahci.ndisk]) < 0) {
+            KERN_WARN("ahci_init: IDENTIFY failed on port %d\n", i);
+        } else if (ahci.ncq && (ident[ATA_ID_SATA_CAP] & ATA_ID_SATA_CAP_NCQ)) {
+            d->ncq = TRUE;
+            d->nslot = MIN(ahci.nslot, (ident[ATA_ID_QUEUE_DEPTH] & 0x1f) + 1);
+        }
+        KERN_INFO("[AHCI] disk %d on port %d, NCQ %s, %d slots.\n",
+                  ahci.ndisk, i, d->ncq ? "on" : "off", d->nslot);
+        ahci.ndisk++;
+    }
+    if (ahci.ndisk == 0)
+        return -1;
+
+    hba_write(HBA_IS, 0xffffffff);
+    hba_write(HBA_GHC, hba_read(HBA_GHC) | HBA_GHC_IE);
+
+    KERN_INFO("[AHCI] %d disk(s), %d slots, HBA NCQ %s.\n",
+              ahci.ndisk, ahci.nslot, ahci.ncq ? "on" : "off");
+    return f.irq_line;
+}
+
+/**
+ * Fill in slot s of disk d with the command for the n bufs in bv.
+ */
+static void ahci_build(struct ahci_disk *d, struct ahci_port_mem *m, int s,
+                       struct buf **bv, int n, bool write)
+{
+    struct ahci_cmd_header *h = &m->cl[s];
+    struct ahci_cmd_table *t = &m->ct[s];
+    uint8_t *fis = t->cfis;
+    uint64_t lba = bv[0]->sector;
+    int i;
+
+    memset(t, 0, sizeof(*t));
+    for (i = 0; i < n; i++) {
+        t->prd[i].dba = (uintptr_t) bv[i]->data;  // identity-mapped
+        t->prd[i].dbau = 0;
+        t->prd[i].dbc = SECTOR_SIZE - 1;
+    }
+
+    fis[0] = FIS_TYPE_REG_H2D;
+    fis[1] = 0x80;  // command, not control
+    fis[4] = lba & 0xff;
+    fis[5] = (lba >> 8) & 0xff;
+    fis[6] = (lba >> 16) & 0xff;
+    fis[7] = 0x40;  // LBA mode
+    fis[8] = (lba >> 24) & 0xff;
+    fis[9] = (lba >> 32) & 0xff;
+    fis[10] = (lba >> 40) & 0xff;
+    if (d->ncq) {
+        fis[2] = write ? ATA_CMD_WRITE_FPDMA_QUEUED : ATA_CMD_READ_FPDMA_QUEUED;
+        fis[3] = n;       // sector count (low) goes in features
+        fis[11] = 0;      // sector count (high)
+        fis[12] = s << 3; // tag
+    } else {
+        fis[2] = write ? ATA_CMD_WRITE_DMA_EXT : ATA_CMD_READ_DMA_EXT;
+        fis[12] = n;      // sector count
+    }
+
+    h->flags = 5 | (write ? CMD_HDR_WRITE : 0);  // 5-dword H2D FIS
+    h->prdtl = n;
+    h->prdbc = 0;
+}
+
+void ahci_rwv(struct buf **bv, int n)
+{
+    struct ahci_disk *d;
+    struct buf *b = bv[0];
+    bool write;
+    int i, s;
+
+    if (n < 1 || n > NDISKMERGE)
+        KERN_PANIC("ahci_rw: bad request size %d", n);
+    for (i = 0; i < n; i++) {
+        if (!(bv[i]->flags & B_BUSY))
+            KERN_PANIC("ahci_rw: buf not busy");
+        if ((bv[i]->flags & (B_VALID | B_DIRTY)) == B_VALID)
+            KERN_PANIC("ahci_rw: nothing to do");
+    }
+    if (b->dev >= (uint32_t) ahci.ndisk)
+        KERN_PANIC("ahci_rw: no disk %d", b->dev);
+
+    d = &ahci.disk[b->dev];
+    write = (b->flags & B_DIRTY) != 0;
+
+    spinlock_acquire(&ahci.lock);
+
+    // Take a free command slot.
+    for (;;) {
+        for (s = 0; s < d->nslot && (d->active & (1u << s)); s++)
+            ;
+        if (s < d->nslot)
+            break;
+        thread_sleep(d, &ahci.lock);
+    }
+    d->active |= 1u << s;
+    d->bufs[s] = bv;
+    d->nbufs[s] = n;
+    ahci_build(d, &port_mem[b->dev], s, bv, n, write);
+
+    AHCI_DEBUG("%s %d sectors at %u, disk %d, slot %d\n",
+               write ? "write" : "read", n, b->sector, b->dev, s);
+    if (d->ncq)
+        port_write(d, PORT_SACT, 1u << s);
+    port_write(d, PORT_CI, 1u << s);
+
+    // Wait for ahci_intr() to say the command is done, or failed.
+    while (!(b->flags & B_ERROR)
+           && (b->flags & (B_VALID | B_DIRTY)) != B_VALID)
+        thread_sleep(b, &ahci.lock);
+
+    spinlock_release(&ahci.lock);
+}
+
+void ahci_rw(struct buf *b)
+{
+    ahci_rwv(&b, 1);
+}
+
+/**
+ * Retire slot s of d: mark its bufs done, or failed if err is set, and
+ * wake their owner and anyone waiting for a slot. Caller holds ahci.lock.
+ */
+static void ahci_complete(struct ahci_disk *d, int s, bool err)
+{
+    struct buf **bv = d->bufs[s];
+    int j;
+
+    AHCI_DEBUG("%s sector %u, disk %d, slot %d\n",
+               err ? "failed" : "done", bv[0]->sector, bv[0]->dev, s);
+    for (j = 0; j < d->nbufs[s]; j++) {
+        if (err) {
+            bv[j]->flags |= B_ERROR;
+        } else {
+            bv[j]->flags |= B_VALID;
+            bv[j]->flags &= ~B_DIRTY;
+        }
+    }
+    thread_wakeup(bv[0]);
+    d->bufs[s] = NULL;
+    d->active &= ~(1u << s);
+    thread_wakeup(d);
+}
+
+void ahci_intr(void)
+{
+    struct ahci_disk *d;
+    uint32_t is, busy, done;
+    int i, s;
+
+    spinlock_acquire(&ahci.lock);
+
+    for (i = 0; i < ahci.ndisk; i++) {
+        d = &ahci.disk[i];
+        is = port_read(d, PORT_IS);
+        port_write(d, PORT_IS, is);
+
+        // A slot is done once the disk has cleared both its bits.
+        busy = port_read(d, PORT_CI) | port_read(d, PORT_SACT);
+        done = d->active & ~busy;
+        for (s = 0; s < NSLOT; s++) {
+            if (done & (1u << s))
+                ahci_complete(d, s, FALSE);
+        }
+
+        // The port stops on an error; whatever is left will not finish.
+        if (is & PORT_IS_TFES) {
+            KERN_WARN("ahci_intr: disk %d error, TFD 0x%x\n",
+                      i, port_read(d, PORT_TFD));
+            ahci_port_recover(d);
+            for (s = 0; s < NSLOT; s++) {
+                if (d->active & (1u << s))
+                    ahci_complete(d, s, TRUE);
+            }
+        }
+    }
+    hba_write(HBA_IS, hba_read(HBA_IS));
+
+    spinlock_release(&ahci.lock);
+}
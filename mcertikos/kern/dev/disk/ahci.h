@@ -0,0 +1,36 @@
+#ifndef _KERN_DEV_DISK_AHCI_H_
+#define _KERN_DEV_DISK_AHCI_H_
+
+#ifdef _KERN_
+
+#include <lib/buf.h>
+
+/**
+ * Find an AHCI controller and start its SATA disk ports.
+ * Return the controller's IRQ, or -1 if there is none.
+ */
+int ahci_init(void);
+
+/**
+ * Complete the commands the controller has finished, in whatever
+ * order they finished, and wake their owners. After an error, recover
+ * the port and fail the commands still outstanding on it.
+ */
+void ahci_intr(void);
+
+/**
+ * Sync buf with disk, like ide_rw(). b->dev selects the n-th SATA disk.
+ * Up to 32 requests per disk are in flight at once, using native
+ * command queuing when both the controller and the disk support it.
+ */
+void ahci_rw(struct buf *b);
+
+/**
+ * Sync the n bufs in bv, which are for consecutive sectors in the same
+ * direction, with one command of n sectors. n is at most NDISKMERGE.
+ */
+void ahci_rwv(struct buf **bv, int n);
+
+#endif  /* _KERN_ */
+
+#endif  /* !_KERN_DEV_DISK_AHCI_H_ */
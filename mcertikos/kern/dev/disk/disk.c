@@ -0,0 +1,131 @@
+/*
+ * Disk driver selection. The buffer cache talks to whichever disk
+ * driver found its device at boot, through disk_rw(), which passes the
+ * request through the I/O scheduler. Requests for RAMDISK_DEV go to the
+ * RAM disk instead, whatever hardware there is.
+ */
+
+#include <lib/debug.h>
+#include <lib/types.h>
+#include <lib/buf.h>
+#include <dev/intr.h>
+
+#include "ide.h"
+#include "virtio_blk.h"
+#include "ahci.h"
+#include "ramdisk.h"
+#include "iosched.h"
+#include "diskstat.h"
+#include "disk.h"
+
+static int ide_attach(void)
+{
+    if (ide_init() < 0)
+        return -1;
+    return IRQ_IDE1;
+}
+
+static struct disk_driver ide_driver = {
+    .name = "ide",
+    .init = ide_attach,
+    .rw = ide_rw,
+    .rwv = ide_rwv,
+    .intr = ide_intr,
+    .depth = 1,  // one transfer at a time; leave the order to the scheduler
+};
+
+static struct disk_driver virtio_blk_driver = {
+    .name = "virtio-blk",
+    .init = virtio_blk_init,
+    .rw = virtio_blk_rw,
+    .rwv = NULL,
+    .intr = virtio_blk_intr,
+    .depth = 8,
+};
+
+static struct disk_driver ahci_driver = {
+    .name = "ahci",
+    .init = ahci_init,
+    .rw = ahci_rw,
+    .rwv = ahci_rwv,
+    .intr = ahci_intr,
+    .depth = 8,  // enough for NCQ to reorder, few enough to still sort
+};
+
+// In order of preference; IDE is the usual fallback.
+static struct disk_driver *drivers[] = {
+    &virtio_blk_driver,
+    &ahci_driver,
+    &ide_driver,
+};
+
+static struct disk_driver *disk;
+static int irq = -1;
+
+void disk_init(void)
+{
+    int i;
+
+    diskstat_init();
+    ramdisk_init();
+    iosched_init();
+
+    for (i = 0; i < sizeof(drivers) / sizeof(drivers[0]); i++) {
+        if ((irq = drivers[i]->init()) >= 0) {
+            disk = drivers[i];
+            KERN_INFO("[DISK] using %s, IRQ %d.\n", disk->name, irq);
+            intr_enable(irq);
+            return;
+        }
+    }
+    KERN_WARN("disk_init: no disk found\n");
+}
+
+int disk_irq(void)
+{
+    return irq;
+}
+
+void disk_intr(void)
+{
+    if (disk != NULL)
+        disk->intr();
+}
+
+void disk_rw(struct buf *b)
+{
+    bool write = (b->flags & B_DIRTY) != 0;
+    uint64_t start = diskstat_begin(b->dev);
+
+    b->flags &= ~B_ERROR;
+    if (b->dev == RAMDISK_DEV) {
+        ramdisk_rw(b);
+    } else {
+        if (disk == NULL)
+            KERN_PANIC("disk_rw: no disk");
+        iosched_rw(b);
+    }
+    diskstat_end(b->dev, write, SECTOR_SIZE, start);
+}
+
+void disk_rwv(struct buf **bv, int n)
+{
+    int i;
+
+    if (disk->rwv != NULL) {
+        disk->rwv(bv, n);
+        return;
+    }
+    for (i = 0; i < n; i++)
+        disk->rw(bv[i]);
+}
+
+int disk_depth(void)
+{
+    return disk != NULL ? disk->depth : 1;
+}
+
+const char *disk_name(void)
+{
+    return disk != NULL ? disk->name : "none";
+}
@@ -0,0 +1,65 @@
+#ifndef _KERN_DEV_DISK_DISK_H_
+#define _KERN_DEV_DISK_DISK_H_
+
+#ifdef _KERN_
+
+#include <lib/buf.h>
+
+#define NDISKMERGE 16  // max bufs in one merged transfer
+
+/**
+ * A disk driver. init() probes for the device and sets it up; it
+ * returns the IRQ the device interrupts on, or -1 if there is no such
+ * device. rw() has the contract of ide_rw(). rwv(), if not NULL, does
+ * up to NDISKMERGE bufs for consecutive sectors as one transfer.
+ * depth is how many requests the I/O scheduler keeps on the device.
+ */
+struct disk_driver {
+    const char *name;
+    int (*init)(void);
+    void (*rw)(struct buf *b);
+    void (*rwv)(struct buf **bv, int n);
+    void (*intr)(void);
+    int depth;
+};
+
+/**
+ * Pick the first driver whose device is present, in order of
+ * preference, and initialize it.
+ */
+void disk_init(void);
+
+/**
+ * The IRQ of the chosen disk, for the trap handler to route to
+ * disk_intr(); -1 if there is no disk.
+ */
+int disk_irq(void);
+
+void disk_intr(void);
+
+/**
+ * Sync buf with disk through the I/O scheduler and the chosen driver,
+ * or with the RAM disk if b->dev is RAMDISK_DEV; see ide_rw().
+ * B_ERROR is set on return if the transfer failed.
+ */
+void disk_rw(struct buf *b);
+
+/**
+ * Hand a request the I/O scheduler has picked to the driver: the n
+ * bufs in bv are for consecutive sectors in the same direction.
+ */
+void disk_rwv(struct buf **bv, int n);
+
+/**
+ * The number of requests to keep in flight on the chosen disk.
+ */
+int disk_depth(void);
+
+/**
+ * The name of the chosen driver, or "none" if there is no disk.
+ */
+const char *disk_name(void);
+
+#endif  /* _KERN_ */
+
+#endif  /* !_KERN_DEV_DISK_DISK_H_ */
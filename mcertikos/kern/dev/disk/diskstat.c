@@ -0,0 +1,130 @@
+/*
+ * Per-device disk accounting: request counts, bytes, log2 latency
+ * histograms, queue depth and buffer cache hits, timestamped with the
+ * TSC. disk_rw() brackets every request with diskstat_begin() and
+ * diskstat_end(); the monitor's diskstat command and sys_diskstat()
+ * read the counters.
+ */
+
+#include <lib/debug.h>
+#include <lib/string.h>
+#include <lib/types.h>
+#include <lib/x86.h>
+#include <lib/spinlock.h>
+#include <dev/tsc.h>
+
+#include "diskstat.h"
+
+static struct {
+    spinlock_t lock;
+    struct diskstat st[NDISKSTAT];
+    uint64_t first[NDISKSTAT];  // TSC of each device's first request
+} ds;
+
+/**
+ * a / b, done with divl so that the kernel does not need libgcc's
+ * 64-bit division.
+ */
+static uint64_t udiv64(uint64_t a, uint32_t b)
+{
+    uint32_t hi = a >> 32, lo = a, qhi, qlo, r;
+
+    qhi = hi / b;
+    r = hi % b;
+    __asm __volatile ("divl %4"
+                      : "=a" (qlo), "=d" (r)
+                      : "a" (lo), "d" (r), "rm" (b));
+    return ((uint64_t) qhi << 32) | qlo;
+}
+
+uint64_t diskstat_tsc_to_us(uint64_t ticks)
+{
+    uint32_t per_us = udiv64(tsc_per_ms, 1000);
+
+    return per_us ? udiv64(ticks, per_us) : 0;
+}
+
+void diskstat_init(void)
+{
+    spinlock_init(&ds.lock);
+    memzero(&ds.st, sizeof(ds.st));
+    memzero(&ds.first, sizeof(ds.first));
+}
+
+uint64_t diskstat_begin(uint32_t dev)
+{
+    uint64_t now = rdtsc();
+    struct diskstat *st;
+
+    if (dev >= NDISKSTAT)
+        return now;
+
+    spinlock_acquire(&ds.lock);
+    st = &ds.st[dev];
+    if (ds.first[dev] == 0)
+        ds.first[dev] = now;
+    if (++st->depth > st->maxdepth)
+        st->maxdepth = st->depth;
+    spinlock_release(&ds.lock);
+    return now;
+}
+
+void diskstat_end(uint32_t dev, bool write, uint32_t len, uint64_t start)
+{
+    uint64_t us = diskstat_tsc_to_us(rdtsc() - start);
+    struct diskstat *st;
+    int i;
+
+    if (dev >= NDISKSTAT)
+        return;
+
+    // Bucket i holds latencies in [2^i, 2^(i+1)) us.
+    for (i = 0; i < NLATBUCKET - 1 && (us >> (i + 1)) != 0; i++)
+        /* do nothing */ ;
+
+    spinlock_acquire(&ds.lock);
+    st = &ds.st[dev];
+    st->ops[write]++;
+    st->bytes[write] += len;
+    st->lat_us[write] += us;
+    st->hist[write][i]++;
+    st->depth--;
+    spinlock_release(&ds.lock);
+}
+
+void diskstat_cache(uint32_t dev, bool hit)
+{
+    if (dev >= NDISKSTAT)
+        return;
+
+    spinlock_acquire(&ds.lock);
+    if (hit)
+        ds.st[dev].cache_hits++;
+    else
+        ds.st[dev].cache_misses++;
+    spinlock_release(&ds.lock);
+}
+
+int diskstat_get(uint32_t dev, struct diskstat *st)
+{
+    uint64_t lookups;
+    uint32_t ms;
+    int rw;
+
+    if (dev >= NDISKSTAT)
+        return -1;
+
+    spinlock_acquire(&ds.lock);
+    *st = ds.st[dev];
+    if (ds.first[dev] != 0)
+        st->elapsed_us = diskstat_tsc_to_us(rdtsc() - ds.first[dev]);
+    spinlock_release(&ds.lock);
+
+    for (rw = 0; rw < 2; rw++)
+        st->avg_us[rw] = st->ops[rw] ? udiv64(st->lat_us[rw], st->ops[rw]) : 0;
+    ms = udiv64(st->elapsed_us, 1000);
+    st->bytes_per_sec = ms ? udiv64((st->bytes[0] + st->bytes[1]) * 1000, ms) : 0;
+    lookups = st->cache_hits + st->cache_misses;
+    st->cache_hit_pct = lookups ? udiv64(st->cache_hits * 100, lookups) : 0;
+    return 0;
+}
@@ -0,0 +1,66 @@
+#ifndef _KERN_DEV_DISK_DISKSTAT_H_
+#define _KERN_DEV_DISK_DISKSTAT_H_
+
+#ifdef _KERN_
+
+#include <lib/types.h>
+
+#define NDISKSTAT  3   // devices accounted: IDE/AHCI disks 0 and 1, RAM disk
+#define NLATBUCKET 24  // latency histogram buckets
+
+/**
+ * Counters of one disk device, indexed [0] for reads and [1] for
+ * writes. hist[rw][i] counts requests that took 2^i to 2^(i+1) - 1 us
+ * (bucket 0 also counts the ones under 1 us; the last bucket counts
+ * everything longer). Latency is from disk_rw() to completion, so it
+ * includes time queued in the I/O scheduler. Mirrored in
+ * user/include/diskstat.h.
+ */
+struct diskstat {
+    uint64_t ops[2];
+    uint64_t bytes[2];
+    uint64_t lat_us[2];      // total latency
+    uint64_t hist[2][NLATBUCKET];
+    uint64_t elapsed_us;     // since the device's first request
+    uint64_t cache_hits;     // buffer cache lookups for this device
+    uint64_t cache_misses;
+    uint32_t depth;          // requests in flight now
+    uint32_t maxdepth;
+    // Derived by diskstat_get():
+    uint32_t avg_us[2];      // mean latency
+    uint32_t bytes_per_sec;  // reads and writes over elapsed_us
+    uint32_t cache_hit_pct;  // buffer cache hit ratio, in percent
+};
+
+void diskstat_init(void);
+
+/**
+ * Note that a request for dev is starting; return its start time, to
+ * be passed to diskstat_end().
+ */
+uint64_t diskstat_begin(uint32_t dev);
+
+/**
+ * Account a request of len bytes for dev that began at start.
+ */
+void diskstat_end(uint32_t dev, bool write, uint32_t len, uint64_t start);
+
+/**
+ * Count a buffer cache lookup for dev.
+ */
+void diskstat_cache(uint32_t dev, bool hit);
+
+/**
+ * Copy the counters of dev into *st. Return 0, or -1 if dev is not
+ * accounted.
+ */
+int diskstat_get(uint32_t dev, struct diskstat *st);
+
+/**
+ * Convert a TSC interval to microseconds.
+ */
+uint64_t diskstat_tsc_to_us(uint64_t ticks);
+
+#endif  /* _KERN_ */
+
+#endif  /* !_KERN_DEV_DISK_DISKSTAT_H_ */
@@ -0,0 +1,356 @@
+/*
+ * Interrupt-driven ATA PIO driver for the primary IDE controller.
+ *
+ * Requests are struct bufs kept on a FIFO queue. Only the request at
+ * the head of the queue is on the disk; ide_intr() completes it and
+ * starts the next one. Requesters sleep on their buf until the
+ * interrupt handler wakes them, so other threads run during disk I/O.
+ *
+ * If the controller can do PCI bus-master DMA, runs of queued requests
+ * for consecutive sectors in the same direction are merged into one
+ * DMA transfer of up to NDMASECT sectors, described by a PRD table that
+ * points at the bufs' data, and complete with a single interrupt.
+ * Otherwise sectors are moved one at a time with PIO. ide_dma() can
+ * switch DMA off at run time, and the TSC ticks the CPU spends in the
+ * driver are counted, so the two can be compared (see ide_stat()).
+ *
+ * The trap handler calls ide_intr() for T_IRQ0 + IRQ_IDE1.
+ */
+
+#include <lib/debug.h>
+#include <lib/gcc.h>
+#include <lib/types.h>
+#include <lib/x86.h>
+#include <lib/spinlock.h>
+#include <lib/buf.h>
+#include <thread/PThread/export.h>
+#include <dev/intr.h>
+#include <dev/pci.h>
+
+#include "ide.h"
+
+#define IDE_DATA     0x1f0  // data port
+#define IDE_NSECT    0x1f2  // sector count
+#define IDE_LBA0     0x1f3  // LBA bits 0-7
+#define IDE_LBA1     0x1f4  // LBA bits 8-15
+#define IDE_LBA2     0x1f5  // LBA bits 16-23
+#define IDE_DRIVE    0x1f6  // drive select, LBA bits 24-27
+#define IDE_STATUS   0x1f7  // status (read)
+#define IDE_CMD      0x1f7  // command (write)
+#define IDE_CTRL     0x3f6  // device control
+
+#define IDE_BSY  0x80
+#define IDE_DRDY 0x40
+#define IDE_DF   0x20
+#define IDE_ERR  0x01
+
+#define IDE_CMD_READ      0x20
+#define IDE_CMD_WRITE     0x30
+#define IDE_CMD_READ_DMA  0xc8
+#define IDE_CMD_WRITE_DMA 0xca
+
+// Bus-master registers of the primary channel, relative to BAR4
+#define BM_CMD    0x0
+#define BM_STATUS 0x2
+#define BM_PRDT   0x4
+
+#define BM_CMD_START 0x01
+#define BM_CMD_READ  0x08  // the controller writes to memory
+
+#define BM_STATUS_ERR  0x02
+#define BM_STATUS_INTR 0x04
+
+#define NDMASECT 16  // max sectors per DMA transfer
+
+#define IDE_PROBE_SPINS 100000  // status reads before giving up at boot
+
+// Physical region descriptor: one contiguous piece of a DMA transfer.
+// A piece may not cross a 64 KB boundary, so a sector can need two.
+struct prd {
+    uint32_t addr;
+    uint16_t len;
+    uint16_t flags;
+};
+
+#define PRD_EOT 0x8000  // last descriptor of the table
+
+static struct prd prdt[2 * NDMASECT] gcc_aligned(256);
+
+static uint16_t bmbase;  // bus-master I/O base; 0 means PIO only
+static bool dmaon;       // use DMA for new transfers
+static bool dmaactive;   // the transfer on the disk uses DMA
+static int nactive;      // bufs at the head of idequeue on the disk
+
+static uint64_t busy;     // TSC ticks spent starting and finishing transfers
+static uint64_t nsector;  // sectors transferred
+
+// idequeue points to the buf now being read/written to the disk.
+// idequeue->qnext points to the next buf to be processed.
+// You must hold idelock while manipulating queue.
+static spinlock_t idelock;
+static struct buf *idequeue;
+
+static bool havedisk1;
+
+/**
+ * Wait for the disk to become ready.
+ * Return -1 if checkerr is set and the disk reports an error.
+ */
+static int ide_wait(bool checkerr)
+{
+    int r;
+
+    while (((r = inb(IDE_STATUS)) & (IDE_BSY | IDE_DRDY)) != IDE_DRDY)
+        /* do nothing */ ;
+    if (checkerr && (r & (IDE_DF | IDE_ERR)) != 0)
+        return -1;
+    return 0;
+}
+
+/**
+ * Wait a bounded time for the controller to become ready.
+ * Return -1 if it never does, or if there is none: a bus without a
+ * controller floats and reads 0xff.
+ */
+static int ide_probe(void)
+{
+    int i, r;
+
+    for (i = 0; i < IDE_PROBE_SPINS; i++) {
+        if ((r = inb(IDE_STATUS)) == 0xff)
+            return -1;
+        if ((r & (IDE_BSY | IDE_DRDY)) == IDE_DRDY)
+            return 0;
+    }
+    return -1;
+}
+
+int ide_init(void)
+{
+    struct pci_func pcif;
+    int i;
+
+    spinlock_init(&idelock);
+    if (ide_probe() < 0) {
+        KERN_INFO("[IDE] no controller.\n");
+        return -1;
+    }
+    intr_enable(IRQ_IDE1);
+
+    // Check if disk 1 is present
+    outb(IDE_DRIVE, 0xe0 | (1 << 4));
+    for (i = 0; i < 1000; i++) {
+        if (inb(IDE_STATUS) != 0) {
+            havedisk1 = TRUE;
+            break;
+        }
+    }
+
+    // Switch back to disk 0.
+    outb(IDE_DRIVE, 0xe0 | (0 << 4));
+
+    KERN_INFO("[IDE] disk 1 %s.\n", havedisk1 ? "present" : "absent");
+
+    // Use bus-master DMA if the controller supports it.
+    if (pci_find_class(PCI_CLASS_STORAGE, PCI_SUBCLASS_IDE, &pcif) == 0
+        && (pcif.progif & 0x80) && (pcif.bar[4] & 1)) {
+        bmbase = pcif.bar[4] & ~3;
+        dmaon = TRUE;
+        pci_enable(&pcif);
+        KERN_INFO("[IDE] bus-master DMA at I/O 0x%x.\n", bmbase);
+    }
+    return 0;
+}
+
+/**
+ * Describe the data of the n bufs starting at b in the PRD table.
+ */
+static void ide_build_prdt(struct buf *b, int n)
+{
+    uint32_t addr, len;
+    int i, j = 0;
+
+    for (i = 0; i < n; i++, b = b->qnext) {
+        addr = (uint32_t) b->data;  // kernel memory is identity-mapped
+        len = SECTOR_SIZE;
+        if ((addr & 0xffff) + len > 0x10000) {
+            prdt[j].addr = addr;
+            prdt[j].len = 0x10000 - (addr & 0xffff);
+            prdt[j++].flags = 0;
+            len -= 0x10000 - (addr & 0xffff);
+            addr += 0x10000 - (addr & 0xffff);
+        }
+        prdt[j].addr = addr;
+        prdt[j].len = len;
+        prdt[j++].flags = 0;
+    }
+    prdt[j - 1].flags = PRD_EOT;
+}
+
+/**
+ * Start the request for b, merged with the requests queued behind it
+ * if DMA is available. Caller must hold idelock.
+ */
+static void ide_start(struct buf *b)
+{
+    struct buf *q;
+    uint64_t t0 = rdtsc();
+    bool write;
+    int n;
+
+    if (b == NULL)
+        KERN_PANIC("ide_start");
+
+    write = (b->flags & B_DIRTY) != 0;
+    dmaactive = dmaon;
+    n = 1;
+    if (dmaactive) {
+        for (q = b->qnext; q != NULL && n < NDMASECT; q = q->qnext, n++) {
+            if (q->dev != b->dev || q->sector != b->sector + n
+                || ((q->flags & B_DIRTY) != 0) != write)
+                break;
+        }
+    }
+    nactive = n;
+
+    ide_wait(FALSE);
+    outb(IDE_CTRL, 0);  // generate interrupt
+    outb(IDE_NSECT, n);
+    outb(IDE_LBA0, b->sector & 0xff);
+    outb(IDE_LBA1, (b->sector >> 8) & 0xff);
+    outb(IDE_LBA2, (b->sector >> 16) & 0xff);
+    outb(IDE_DRIVE, 0xe0 | ((b->dev & 1) << 4) | ((b->sector >> 24) & 0x0f));
+    if (dmaactive) {
+        ide_build_prdt(b, n);
+        outb(bmbase + BM_CMD, 0);
+        outl(bmbase + BM_PRDT, (uint32_t) prdt);
+        outb(bmbase + BM_STATUS, BM_STATUS_ERR | BM_STATUS_INTR);  // clear
+        outb(bmbase + BM_CMD, write ? 0 : BM_CMD_READ);
+        outb(IDE_CMD, write ? IDE_CMD_WRITE_DMA : IDE_CMD_READ_DMA);
+        outb(bmbase + BM_CMD, (write ? 0 : BM_CMD_READ) | BM_CMD_START);
+    } else if (write) {
+        outb(IDE_CMD, IDE_CMD_WRITE);
+        outsl(IDE_DATA, b->data, SECTOR_SIZE / 4);
+    } else {
+        outb(IDE_CMD, IDE_CMD_READ);
+    }
+    busy += rdtsc() - t0;
+}
+
+void ide_intr(void)
+{
+    struct buf *b;
+    uint64_t t0 = rdtsc();
+    uint8_t st;
+    bool err;
+    int i;
+
+    spinlock_acquire(&idelock);
+    if ((b = idequeue) == NULL) {
+        spinlock_release(&idelock);
+        // KERN_DEBUG("spurious IDE interrupt\n");
+        return;
+    }
+
+    if (dmaactive) {
+        // The whole transfer is done; stop the engine.
+        st = inb(bmbase + BM_STATUS);
+        outb(bmbase + BM_CMD, 0);
+        outb(bmbase + BM_STATUS, BM_STATUS_ERR | BM_STATUS_INTR);
+        err = (st & BM_STATUS_ERR) || ide_wait(TRUE) < 0;
+    } else {
+        err = ide_wait(TRUE) < 0;
+        // Read data if needed.
+        if (!err && !(b->flags & B_DIRTY))
+            insl(IDE_DATA, b->data, SECTOR_SIZE / 4);
+    }
+    if (err)
+        KERN_WARN("ide_intr: I/O error at sector %u\n", b->sector);
+
+    // Wake the threads waiting for the bufs of this transfer.
+    for (i = 0; i < nactive; i++) {
+        b = idequeue;
+        idequeue = b->qnext;
+        if (err) {
+            b->flags |= B_ERROR;
+        } else {
+            b->flags |= B_VALID;
+            b->flags &= ~B_DIRTY;
+        }
+        thread_wakeup(b);
+    }
+    nsector += nactive;
+    busy += rdtsc() - t0;
+
+    // Start disk on next buf in queue.
+    if (idequeue != NULL)
+        ide_start(idequeue);
+
+    spinlock_release(&idelock);
+}
+
+int ide_dma(int on)
+{
+    int was = dmaon;
+
+    if (bmbase == 0)
+        return -1;
+    if (on >= 0) {
+        spinlock_acquire(&idelock);
+        dmaon = on != 0;  // the transfer on the disk keeps its mode
+        spinlock_release(&idelock);
+    }
+    return was;
+}
+
+void ide_stat(uint64_t *ticks, uint64_t *sectors)
+{
+    spinlock_acquire(&idelock);
+    *ticks = busy;
+    *sectors = nsector;
+    spinlock_release(&idelock);
+}
+
+void ide_rwv(struct buf **bv, int n)
+{
+    struct buf **pp;
+    int i;
+
+    for (i = 0; i < n; i++) {
+        if (!(bv[i]->flags & B_BUSY))
+            KERN_PANIC("ide_rw: buf not busy");
+        if ((bv[i]->flags & (B_VALID | B_DIRTY)) == B_VALID)
+            KERN_PANIC("ide_rw: nothing to do");
+        if (bv[i]->dev != 0 && !havedisk1)
+            KERN_PANIC("ide_rw: ide disk 1 not present");
+    }
+
+    spinlock_acquire(&idelock);
+
+    // Append the bufs to idequeue, in order.
+    for (pp = &idequeue; *pp != NULL; pp = &(*pp)->qnext)
+        /* do nothing */ ;
+    for (i = 0; i < n; i++) {
+        bv[i]->qnext = NULL;
+        *pp = bv[i];
+        pp = &bv[i]->qnext;
+    }
+
+    // Start disk if necessary.
+    if (idequeue == bv[0])
+        ide_start(bv[0]);
+
+    // Wait for the requests to finish.
+    for (i = 0; i < n; i++) {
+        while (!(bv[i]->flags & B_ERROR)
+               && (bv[i]->flags & (B_VALID | B_DIRTY)) != B_VALID)
+            thread_sleep(bv[i], &idelock);
+    }
+
+    spinlock_release(&idelock);
+}
+
+void ide_rw(struct buf *b)
+{
+    ide_rwv(&b, 1);
+}
@@ -0,0 +1,51 @@
+#ifndef _KERN_DEV_DISK_IDE_H_
+#define _KERN_DEV_DISK_IDE_H_
+
+#ifdef _KERN_
+
+#include <lib/buf.h>
+
+/**
+ * Probe the primary IDE controller and enable its interrupt.
+ * Return 0, or -1 if there is no controller.
+ */
+int ide_init(void);
+
+/**
+ * IRQ_IDE1 handler: finish the request at the head of the queue, wake
+ * up its owner and start the next one.
+ */
+void ide_intr(void);
+
+/**
+ * Sync buf with disk.
+ * If B_DIRTY is set, write buf to disk, clear B_DIRTY, set B_VALID.
+ * Else if B_VALID is not set, read buf from disk, set B_VALID.
+ * If the transfer fails, set B_ERROR and leave B_VALID and B_DIRTY alone.
+ * The calling thread sleeps until the request is done.
+ */
+void ide_rw(struct buf *b);
+
+/**
+ * Sync the n bufs in bv, which are for consecutive sectors in the same
+ * direction, like ide_rw(). They are queued together, so with DMA they
+ * go to the disk as one transfer.
+ */
+void ide_rwv(struct buf **bv, int n);
+
+/**
+ * Use DMA for new transfers if on is 1, PIO if it is 0, or leave it
+ * alone if it is -1. Return the previous setting, or -1 if the
+ * controller cannot do DMA.
+ */
+int ide_dma(int on);
+
+/**
+ * Get the TSC ticks the CPU has spent starting and finishing transfers,
+ * PIO copies included, and the number of sectors transferred.
+ */
+void ide_stat(uint64_t *ticks, uint64_t *sectors);
+
+#endif  /* _KERN_ */
+
+#endif  /* !_KERN_DEV_DISK_IDE_H_ */
@@ -0,0 +1,342 @@
+/*
+ * I/O scheduling between the buffer cache and the disk driver.
+ *
+ * disk_rw() queues each buf as a request, or merges it into a queued
+ * request for the sector just before or after it, so that runs of
+ * sectors reach the driver as one transfer. At most disk_depth()
+ * requests are on the disk at a time; whenever one finishes, the
+ * scheduler in use picks which queued request goes next:
+ *
+ *  noop      first come, first served.
+ *  clook     C-LOOK elevator: sweep up through the queued sectors from
+ *            where the head is, then jump back to the lowest one.
+ *  deadline  C-LOOK, except that a read queued for READ_EXPIRE ms or a
+ *            write queued for WRITE_EXPIRE ms goes next, so a long
+ *            sweep cannot starve a request.
+ *
+ * The thread that queued a request sleeps until it is dispatched, then
+ * does the transfer itself and wakes the owners of the bufs merged in.
+ */
+
+#include <lib/debug.h>
+#include <lib/string.h>
+#include <lib/types.h>
+#include <lib/x86.h>
+#include <lib/spinlock.h>
+#include <lib/buf.h>
+#include <thread/PThread/export.h>
+#include <dev/tsc.h>
+
+#include "disk.h"
+#include "iosched.h"
+
+#define READ_EXPIRE  500   // ms a read may wait before it jumps the queue
+#define WRITE_EXPIRE 5000  // ms a write may wait before it jumps the queue
+
+/**
+ * Requests are sorted by disk, then sector.
+ */
+static uint64_t ioreq_key(struct ioreq *r)
+{
+    return ((uint64_t) r->dev << 32) | r->sector;
+}
+
+static void sorted_insert(struct ioreq **list, struct ioreq *r)
+{
+    struct ioreq **pp;
+
+    for (pp = list; *pp != NULL && ioreq_key(*pp) <= ioreq_key(r);
+         pp = &(*pp)->next)
+        /* do nothing */ ;
+    r->next = *pp;
+    *pp = r;
+}
+
+static void sorted_remove(struct ioreq **list, struct ioreq *r)
+{
+    struct ioreq **pp;
+
+    for (pp = list; *pp != r; pp = &(*pp)->next)
+        /* do nothing */ ;
+    *pp = r->next;
+}
+
+/**
+ * Take the first request at or past *pos off the sorted list, wrapping
+ * around to the lowest one, and move *pos past it.
+ */
+static struct ioreq *clook_take(struct ioreq **list, uint64_t *pos)
+{
+    struct ioreq **pp, *r;
+
+    if (*list == NULL)
+        return NULL;
+    for (pp = list; *pp != NULL && ioreq_key(*pp) < *pos; pp = &(*pp)->next)
+        /* do nothing */ ;
+    if (*pp == NULL)
+        pp = list;
+    r = *pp;
+    *pp = r->next;
+    *pos = ioreq_key(r) + r->n;
+    return r;
+}
+
+/*
+ * noop
+ */
+
+static struct ioreq *noop_queue;
+
+static void noop_add(struct ioreq *r)
+{
+    struct ioreq **pp;
+
+    for (pp = &noop_queue; *pp != NULL; pp = &(*pp)->next)
+        /* do nothing */ ;
+    r->next = NULL;
+    *pp = r;
+}
+
+static struct ioreq *noop_next(void)
+{
+    struct ioreq *r;
+
+    if ((r = noop_queue) != NULL)
+        noop_queue = r->next;
+    return r;
+}
+
+/*
+ * clook
+ */
+
+static struct {
+    struct ioreq *sorted;
+    uint64_t pos;  // key just past the last request dispatched
+} clook;
+
+static void clook_add(struct ioreq *r)
+{
+    sorted_insert(&clook.sorted, r);
+}
+
+static struct ioreq *clook_next(void)
+{
+    return clook_take(&clook.sorted, &clook.pos);
+}
+
+/*
+ * deadline
+ */
+
+static struct {
+    struct ioreq *sorted;
+    struct ioreq *fifo[2];  // reads, writes; oldest first
+    uint64_t pos;
+} dl;
+
+static void deadline_add(struct ioreq *r)
+{
+    struct ioreq **pp;
+
+    r->deadline = r->queued
+        + (r->write ? WRITE_EXPIRE : READ_EXPIRE) * tsc_per_ms;
+    sorted_insert(&dl.sorted, r);
+    for (pp = &dl.fifo[r->write]; *pp != NULL; pp = &(*pp)->fnext)
+        /* do nothing */ ;
+    r->fnext = NULL;
+    *pp = r;
+}
+
+static struct ioreq *deadline_next(void)
+{
+    struct ioreq *r = NULL, **pp;
+    uint64_t now = rdtsc();
+    int i;
+
+    // Expired reads first, then expired writes.
+    for (i = 0; i < 2 && r == NULL; i++) {
+        if (dl.fifo[i] != NULL && now >= dl.fifo[i]->deadline) {
+            r = dl.fifo[i];
+            sorted_remove(&dl.sorted, r);
+            dl.pos = ioreq_key(r) + r->n;
+        }
+    }
+    if (r == NULL && (r = clook_take(&dl.sorted, &dl.pos)) == NULL)
+        return NULL;
+
+    for (pp = &dl.fifo[r->write]; *pp != r; pp = &(*pp)->fnext)
+        /* do nothing */ ;
+    *pp = r->fnext;
+    return r;
+}
+
+static struct iosched scheds[] = {
+    { .name = "noop", .add = noop_add, .next = noop_next },
+    { .name = "clook", .add = clook_add, .next = clook_next },
+    { .name = "deadline", .add = deadline_add, .next = deadline_next },
+};
+
+#define NSCHED (sizeof(scheds) / sizeof(scheds[0]))
+
+static struct {
+    spinlock_t lock;
+    struct iosched *cur;
+    struct ioreq *queue;  // every queued request, oldest first, via all
+    int inflight;         // requests dispatched and not yet done
+} iosched;
+
+void iosched_init(void)
+{
+    spinlock_init(&iosched.lock);
+    iosched.cur = &scheds[2];
+}
+
+/**
+ * Add b to a queued request for the sector just before or after it,
+ * in the same direction. Return the request, or NULL if there is none.
+ */
+static struct ioreq *iosched_merge(struct buf *b)
+{
+    struct ioreq *r;
+    bool write = (b->flags & B_DIRTY) != 0;
+
+    for (r = iosched.queue; r != NULL; r = r->all) {
+        if (r->dev != b->dev || r->write != write || r->n == NDISKMERGE)
+            continue;
+        if (b->sector == r->sector + r->n) {
+            r->bufs[r->n++] = b;
+            return r;
+        }
+        if (b->sector + 1 == r->sector) {
+            memmove(&r->bufs[1], &r->bufs[0], r->n * sizeof(r->bufs[0]));
+            r->bufs[0] = b;
+            r->sector--;
+            r->n++;
+            return r;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Dispatch queued requests until the disk has disk_depth() of them.
+ * Caller must hold iosched.lock.
+ */
+static void iosched_kick(void)
+{
+    struct iosched *s = iosched.cur;
+    struct ioreq *r, **pp;
+
+    while (iosched.inflight < disk_depth() && (r = s->next()) != NULL) {
+        for (pp = &iosched.queue; *pp != r; pp = &(*pp)->all)
+            /* do nothing */ ;
+        *pp = r->all;
+
+        s->stat.nreq++;
+        s->stat.depth--;
+        s->stat.wait += rdtsc() - r->queued;
+        iosched.inflight++;
+        r->dispatched = TRUE;
+        thread_wakeup(r);
+    }
+}
+
+void iosched_rw(struct buf *b)
+{
+    struct iosched *s;
+    struct ioreq req, *r, **pp;
+    int i;
+
+    spinlock_acquire(&iosched.lock);
+    s = iosched.cur;
+
+    if ((r = iosched_merge(b)) != NULL) {
+        // The owner of r wakes us once the transfer is done.
+        s->stat.nmerge++;
+        while (!(b->flags & B_ERROR)
+               && (b->flags & (B_VALID | B_DIRTY)) != B_VALID)
+            thread_sleep(b, &iosched.lock);
+        spinlock_release(&iosched.lock);
+        return;
+    }
+
+    r = &req;
+    r->bufs[0] = b;
+    r->n = 1;
+    r->dev = b->dev;
+    r->sector = b->sector;
+    r->write = (b->flags & B_DIRTY) != 0;
+    r->dispatched = FALSE;
+    r->queued = rdtsc();
+    r->all = NULL;
+    for (pp = &iosched.queue; *pp != NULL; pp = &(*pp)->all)
+        /* do nothing */ ;
+    *pp = r;
+    s->add(r);
+    if (++s->stat.depth > s->stat.maxdepth)
+        s->stat.maxdepth = s->stat.depth;
+
+    iosched_kick();
+    while (!r->dispatched)
+        thread_sleep(r, &iosched.lock);
+    spinlock_release(&iosched.lock);
+
+    disk_rwv(r->bufs, r->n);
+
+    spinlock_acquire(&iosched.lock);
+    iosched.inflight--;
+    for (i = 0; i < r->n; i++) {
+        if (r->bufs[i] != b)
+            thread_wakeup(r->bufs[i]);
+    }
+    iosched_kick();
+    spinlock_release(&iosched.lock);
+}
+
+int iosched_select(const char *name)
+{
+    struct iosched *old, *s = NULL;
+    struct ioreq *r;
+    int i;
+
+    for (i = 0; i < NSCHED; i++) {
+        if (strcmp(scheds[i].name, name) == 0)
+            s = &scheds[i];
+    }
+    if (s == NULL)
+        return -1;
+
+    spinlock_acquire(&iosched.lock);
+    old = iosched.cur;
+    if (s != old) {
+        // Empty the old scheduler and requeue in arrival order.
+        while (old->next() != NULL)
+            /* do nothing */ ;
+        old->stat.depth = 0;
+        for (r = iosched.queue; r != NULL; r = r->all) {
+            s->add(r);
+            if (++s->stat.depth > s->stat.maxdepth)
+                s->stat.maxdepth = s->stat.depth;
+        }
+        iosched.cur = s;
+        KERN_INFO("[IOSCHED] switched from %s to %s.\n", old->name, s->name);
+    }
+    spinlock_release(&iosched.lock);
+    return 0;
+}
+
+const char *iosched_stat(int i, struct iosched_stat *st)
+{
+    if (i < 0 || i >= NSCHED)
+        return NULL;
+    spinlock_acquire(&iosched.lock);
+    *st = scheds[i].stat;
+    spinlock_release(&iosched.lock);
+    return scheds[i].name;
+}
+
+const char *iosched_current(void)
+{
+    return iosched.cur->name;
+}
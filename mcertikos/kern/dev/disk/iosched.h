@@ -0,0 +1,77 @@
+#ifndef _KERN_DEV_DISK_IOSCHED_H_
+#define _KERN_DEV_DISK_IOSCHED_H_
+
+#ifdef _KERN_
+
+#include <lib/types.h>
+#include <lib/buf.h>
+
+#include "disk.h"
+
+/**
+ * A disk request: up to NDISKMERGE bufs for consecutive sectors of one
+ * disk, all read or all written. It lives on the stack of the thread
+ * that queued it, which hands it to the driver once it is dispatched.
+ */
+struct ioreq {
+    struct buf *bufs[NDISKMERGE];
+    int n;
+    uint32_t dev;
+    uint32_t sector;     // sector of bufs[0]
+    bool write;
+    bool dispatched;
+    uint64_t queued;     // TSC when queued
+    uint64_t deadline;   // TSC by which the deadline scheduler sends it
+    struct ioreq *all;   // every queued request, for merging
+    struct ioreq *next;  // scheduler's list
+    struct ioreq *fnext; // deadline scheduler's FIFO
+};
+
+struct iosched_stat {
+    uint64_t nreq;      // requests dispatched
+    uint64_t nmerge;    // bufs merged into a queued request
+    uint64_t wait;      // total TSC ticks requests spent queued
+    uint32_t depth;     // requests queued now
+    uint32_t maxdepth;
+};
+
+/**
+ * An I/O scheduler. add() queues a new request; next() takes the
+ * request to dispatch next off the queue, or returns NULL if it is
+ * empty.
+ */
+struct iosched {
+    const char *name;
+    void (*add)(struct ioreq *r);
+    struct ioreq *(*next)(void);
+    struct iosched_stat stat;
+};
+
+void iosched_init(void);
+
+/**
+ * Queue b, merging it into a queued request for the sector before or
+ * after it if there is one, and sleep until it is done.
+ */
+void iosched_rw(struct buf *b);
+
+/**
+ * Switch to the scheduler called name ("noop", "deadline" or "clook"),
+ * moving the queued requests over. Return 0, or -1 if there is none.
+ */
+int iosched_select(const char *name);
+
+/**
+ * Copy the counters of the i-th scheduler into *st and return its
+ * name, or return NULL if there is no i-th scheduler.
+ */
+const char *iosched_stat(int i, struct iosched_stat *st);
+
+/**
+ * The name of the scheduler in use.
+ */
+const char *iosched_current(void);
+
+#endif  /* _KERN_ */
+
+#endif  /* !_KERN_DEV_DISK_IOSCHED_H_ */
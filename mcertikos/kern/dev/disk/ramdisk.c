@@ -0,0 +1,85 @@
+/*
+ * A block device held in memory, so that file system runs do not
+ * depend on emulated disk timing.
+ *
+ * The disk exists only in kernels built with RAMDISK=1. Its sectors
+ * live in pages taken from the physical allocator at boot, eight to a
+ * page; the pages need not be contiguous. The build runs mkfs and links
+ * the image into the kernel, and the disk is loaded from it. Transfers
+ * are plain copies and complete before ramdisk_rw() returns.
+ */
+
+#include <lib/debug.h>
+#include <lib/string.h>
+#include <lib/types.h>
+#include <lib/x86.h>
+#include <lib/buf.h>
+#include <pmm/MATOp/export.h>
+
+#include "ramdisk.h"
+
+#define SECT_PER_PAGE (PAGESIZE / SECTOR_SIZE)
+#define NRAMPAGE      (RAMDISK_NSECT / SECT_PER_PAGE)
+
+// The image made by mkfs, if the kernel was linked with one.
+extern uint8_t _binary___obj_fs_img_start[] __attribute__((weak));
+extern uint8_t _binary___obj_fs_img_end[] __attribute__((weak));
+
+static struct {
+    uint32_t nsect;
+    uint8_t *pages[NRAMPAGE];
+} ramdisk;
+
+void ramdisk_init(void)
+{
+#ifdef RAMDISK
+    uint8_t *img = _binary___obj_fs_img_start;
+    uint32_t imgsize = 0, pi, i, n;
+
+    if (img != NULL)
+        imgsize = _binary___obj_fs_img_end - _binary___obj_fs_img_start;
+    if (imgsize > RAMDISK_NSECT * SECTOR_SIZE) {
+        KERN_WARN("ramdisk_init: image of %d bytes truncated\n", imgsize);
+        imgsize = RAMDISK_NSECT * SECTOR_SIZE;
+    }
+
+    for (i = 0; i < NRAMPAGE; i++) {
+        if ((pi = palloc()) == 0)
+            break;
+        ramdisk.pages[i] = (uint8_t *) (pi * PAGESIZE);
+        memzero(ramdisk.pages[i], PAGESIZE);
+        if (i * PAGESIZE < imgsize) {
+            n = MIN(imgsize - i * PAGESIZE, PAGESIZE);
+            memcpy(ramdisk.pages[i], img + i * PAGESIZE, n);
+        }
+    }
+    ramdisk.nsect = i * SECT_PER_PAGE;
+
+    KERN_INFO("[RAMDISK] %d sectors, %s.\n",
+              ramdisk.nsect, imgsize ? "loaded from image" : "blank");
+#endif
+}
+
+void ramdisk_rw(struct buf *b)
+{
+    uint8_t *p;
+
+    if (!(b->flags & B_BUSY))
+        KERN_PANIC("ramdisk_rw: buf not busy");
+    if ((b->flags & (B_VALID | B_DIRTY)) == B_VALID)
+        KERN_PANIC("ramdisk_rw: nothing to do");
+    if (ramdisk.nsect == 0)
+        KERN_PANIC("ramdisk_rw: no RAM disk; build with RAMDISK=1");
+    if (b->sector >= ramdisk.nsect)
+        KERN_PANIC("ramdisk_rw: sector %d out of range", b->sector);
+
+    p = ramdisk.pages[b->sector / SECT_PER_PAGE]
+        + (b->sector % SECT_PER_PAGE) * SECTOR_SIZE;
+    if (b->flags & B_DIRTY) {
+        memcpy(p, b->data, SECTOR_SIZE);
+        b->flags &= ~B_DIRTY;
+    } else {
+        memcpy(b->data, p, SECTOR_SIZE);
+    }
+    b->flags |= B_VALID;
+}
@@ -0,0 +1,25 @@
+#ifndef _KERN_DEV_DISK_RAMDISK_H_
+#define _KERN_DEV_DISK_RAMDISK_H_
+
+#ifdef _KERN_
+
+#include <lib/buf.h>
+
+#define RAMDISK_DEV   2     // device number of the RAM disk
+#define RAMDISK_NSECT 1024  // size of a blank RAM disk, as made by mkfs
+
+/**
+ * Set up the RAM disk in physical pages, as a copy of the file system
+ * image linked into the kernel, or RAMDISK_NSECT zeroed sectors if
+ * there is none. Does nothing unless built with RAMDISK=1 make.
+ */
+void ramdisk_init(void);
+
+/**
+ * Sync buf with the RAM disk, like ide_rw(). Never sleeps.
+ */
+void ramdisk_rw(struct buf *b);
+
+#endif  /* _KERN_ */
+
+#endif  /* !_KERN_DEV_DISK_RAMDISK_H_ */
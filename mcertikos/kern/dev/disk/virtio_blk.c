@@ -0,0 +1,239 @@
+/*
+ * Driver for legacy (virtio 0.9.5) virtio-blk PCI devices, as emulated
+ * by QEMU with -drive if=virtio.
+ *
+ * Each request takes three descriptors of the single virtqueue: the
+ * request header, the sector data (the buf's own data, so there is no
+ * copy) and the status byte. Request slot r always uses descriptors
+ * 3r .. 3r + 2, so allocating a request is taking a free slot. The
+ * requester sleeps on its buf; virtio_blk_intr() walks the used ring,
+ * marks the bufs done (or B_ERROR) and wakes them, so many requests can
+ * be in flight at once.
+ */
+
+#include <lib/debug.h>
+#include <lib/gcc.h>
+#include <lib/string.h>
+#include <lib/types.h>
+#include <lib/x86.h>
+#include <lib/spinlock.h>
+#include <lib/buf.h>
+#include <thread/PThread/export.h>
+#include <dev/pci.h>
+
+#include "virtio_blk.h"
+
+#define VIRTIO_VENDOR       0x1af4
+#define VIRTIO_BLK_DEVICE   0x1001  // legacy/transitional block device
+
+// Legacy virtio PCI registers, relative to BAR0
+#define VIRTIO_HOST_FEATURES  0x00
+#define VIRTIO_GUEST_FEATURES 0x04
+#define VIRTIO_QUEUE_PFN      0x08
+#define VIRTIO_QUEUE_SIZE     0x0c
+#define VIRTIO_QUEUE_SEL      0x0e
+#define VIRTIO_QUEUE_NOTIFY   0x10
+#define VIRTIO_STATUS         0x12
+#define VIRTIO_ISR            0x13
+
+#define VIRTIO_STATUS_ACK       0x01
+#define VIRTIO_STATUS_DRIVER    0x02
+#define VIRTIO_STATUS_DRIVER_OK 0x04
+#define VIRTIO_STATUS_FAILED    0x80
+
+#define VRING_DESC_F_NEXT  1
+#define VRING_DESC_F_WRITE 2  // device writes (vs. reads) the buffer
+
+#define VIRTIO_BLK_T_IN  0  // read
+#define VIRTIO_BLK_T_OUT 1  // write
+
+#define VRING_ALIGN 4096
+#define VQ_MAX      256  // largest queue we have memory for
+#define NVREQ       (VQ_MAX / 3)
+
+struct vring_desc {
+    uint64_t addr;
+    uint32_t len;
+    uint16_t flags;
+    uint16_t next;
+};
+
+struct vring_avail {
+    uint16_t flags;
+    uint16_t idx;
+    uint16_t ring[];
+};
+
+struct vring_used_elem {
+    uint32_t id;
+    uint32_t len;
+};
+
+struct vring_used {
+    uint16_t flags;
+    uint16_t idx;
+    struct vring_used_elem ring[];
+};
+
+struct virtio_blk_req {
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t sector;
+};
+
+// The virtqueue in the legacy layout: descriptors and available ring,
+// then the used ring on the next VRING_ALIGN boundary.
+static uint8_t vq_mem[3 * VRING_ALIGN] gcc_aligned(VRING_ALIGN);
+
+static struct {
+    spinlock_t lock;
+    uint16_t iobase;
+    uint16_t qsize;
+    struct vring_desc *desc;
+    struct vring_avail *avail;
+    volatile struct vring_used *used;
+    uint16_t used_idx;  // next used entry to look at
+
+    int nreq;
+    bool busy[NVREQ];
+    struct virtio_blk_req hdr[NVREQ];
+    volatile uint8_t status[NVREQ];
+    struct buf *bufs[NVREQ];
+} vblk;
+
+int virtio_blk_init(void)
+{
+    struct pci_func f;
+    uint16_t n;
+
+    if (pci_find_device(VIRTIO_VENDOR, VIRTIO_BLK_DEVICE, &f) != 0)
+        return -1;
+    if ((f.bar[0] & 1) == 0)
+        return -1;  // legacy devices have an I/O BAR0
+    pci_enable(&f);
+
+    spinlock_init(&vblk.lock);
+    vblk.iobase = f.bar[0] & ~3;
+
+    outb(vblk.iobase + VIRTIO_STATUS, 0);  // reset
+    outb(vblk.iobase + VIRTIO_STATUS, VIRTIO_STATUS_ACK);
+    outb(vblk.iobase + VIRTIO_STATUS, VIRTIO_STATUS_ACK | VIRTIO_STATUS_DRIVER);
+    outl(vblk.iobase + VIRTIO_GUEST_FEATURES, 0);  // no optional features
+
+    outw(vblk.iobase + VIRTIO_QUEUE_SEL, 0);
+    n = inw(vblk.iobase + VIRTIO_QUEUE_SIZE);
+    if (n == 0 || n > VQ_MAX) {
+        KERN_WARN("virtio_blk_init: unsupported queue size %d\n", n);
+        outb(vblk.iobase + VIRTIO_STATUS, VIRTIO_STATUS_FAILED);
+        return -1;
+    }
+    vblk.qsize = n;
+    vblk.nreq = n / 3;
+
+    memset(vq_mem, 0, sizeof(vq_mem));
+    vblk.desc = (struct vring_desc *) vq_mem;
+    vblk.avail = (struct vring_avail *) (vq_mem + n * sizeof(struct vring_desc));
+    vblk.used = (struct vring_used *)
+        ROUNDUP((uintptr_t) &vblk.avail->ring[n] + sizeof(uint16_t), VRING_ALIGN);
+    vblk.used_idx = 0;
+
+    // Kernel memory is identity-mapped, so this is the physical address.
+    outl(vblk.iobase + VIRTIO_QUEUE_PFN, (uintptr_t) vq_mem / VRING_ALIGN);
+    outb(vblk.iobase + VIRTIO_STATUS,
+         VIRTIO_STATUS_ACK | VIRTIO_STATUS_DRIVER | VIRTIO_STATUS_DRIVER_OK);
+
+    KERN_INFO("[VIRTIO] block device at I/O 0x%x, queue size %d.\n",
+              vblk.iobase, n);
+    return f.irq_line;
+}
+
+void virtio_blk_rw(struct buf *b)
+{
+    struct vring_desc *d;
+    bool write;
+    int r;
+
+    if (!(b->flags & B_BUSY))
+        KERN_PANIC("virtio_blk_rw: buf not busy");
+    if ((b->flags & (B_VALID | B_DIRTY)) == B_VALID)
+        KERN_PANIC("virtio_blk_rw: nothing to do");
+
+    write = (b->flags & B_DIRTY) != 0;
+
+    spinlock_acquire(&vblk.lock);
+
+    // Take a free request slot.
+    for (;;) {
+        for (r = 0; r < vblk.nreq && vblk.busy[r]; r++)
+            ;
+        if (r < vblk.nreq)
+            break;
+        thread_sleep(&vblk.busy, &vblk.lock);
+    }
+    vblk.busy[r] = TRUE;
+    vblk.bufs[r] = b;
+    vblk.hdr[r].type = write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN;
+    vblk.hdr[r].reserved = 0;
+    vblk.hdr[r].sector = b->sector;
+    vblk.status[r] = 0xff;
+
+    d = &vblk.desc[3 * r];
+    d[0].addr = (uintptr_t) &vblk.hdr[r];
+    d[0].len = sizeof(struct virtio_blk_req);
+    d[0].flags = VRING_DESC_F_NEXT;
+    d[0].next = 3 * r + 1;
+    d[1].addr = (uintptr_t) b->data;
+    d[1].len = SECTOR_SIZE;
+    d[1].flags = VRING_DESC_F_NEXT | (write ? 0 : VRING_DESC_F_WRITE);
+    d[1].next = 3 * r + 2;
+    d[2].addr = (uintptr_t) &vblk.status[r];
+    d[2].len = 1;
+    d[2].flags = VRING_DESC_F_WRITE;
+    d[2].next = 0;
+
+    vblk.avail->ring[vblk.avail->idx % vblk.qsize] = 3 * r;
+    asm volatile ("" ::: "memory");  // descriptors before the index
+    vblk.avail->idx++;
+    asm volatile ("" ::: "memory");
+    outw(vblk.iobase + VIRTIO_QUEUE_NOTIFY, 0);
+
+    // Wait for virtio_blk_intr() to say the request is done, or failed.
+    while (!(b->flags & B_ERROR)
+           && (b->flags & (B_VALID | B_DIRTY)) != B_VALID)
+        thread_sleep(b, &vblk.lock);
+
+    spinlock_release(&vblk.lock);
+}
+
+void virtio_blk_intr(void)
+{
+    struct buf *b;
+    int r;
+
+    spinlock_acquire(&vblk.lock);
+
+    inb(vblk.iobase + VIRTIO_ISR);  // reading acknowledges the interrupt
+
+    while (vblk.used_idx != vblk.used->idx) {
+        asm volatile ("" ::: "memory");
+        r = vblk.used->ring[vblk.used_idx % vblk.qsize].id / 3;
+        vblk.used_idx++;
+
+        b = vblk.bufs[r];
+        if (vblk.status[r] != 0) {
+            KERN_WARN("virtio_blk_intr: error %d at sector %u\n",
+                      vblk.status[r], b->sector);
+            b->flags |= B_ERROR;
+        } else {
+            b->flags |= B_VALID;
+            b->flags &= ~B_DIRTY;
+        }
+        thread_wakeup(b);
+
+        vblk.bufs[r] = NULL;
+        vblk.busy[r] = FALSE;
+        thread_wakeup(&vblk.busy);
+    }
+
+    spinlock_release(&vblk.lock);
+}
@@ -0,0 +1,27 @@
+#ifndef _KERN_DEV_DISK_VIRTIO_BLK_H_
+#define _KERN_DEV_DISK_VIRTIO_BLK_H_
+
+#ifdef _KERN_
+
+#include <lib/buf.h>
+
+/**
+ * Find and set up a legacy virtio-blk PCI device.
+ * Return its IRQ, or -1 if there is none.
+ */
+int virtio_blk_init(void);
+
+/**
+ * Complete the requests the device has finished and wake their owners.
+ */
+void virtio_blk_intr(void);
+
+/**
+ * Sync buf with disk, like ide_rw(). Any number of threads may have
+ * requests in flight at once, up to the size of the virtqueue.
+ */
+void virtio_blk_rw(struct buf *b);
+
+#endif  /* _KERN_ */
+
+#endif  /* !_KERN_DEV_DISK_VIRTIO_BLK_H_ */
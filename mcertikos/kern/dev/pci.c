@@ -0,0 +1,112 @@
+/*
+ * PCI configuration space access through configuration mechanism #1
+ * (I/O ports 0xcf8/0xcfc), and a bus scan to find devices.
+ */
+
+#include <lib/types.h>
+#include <lib/x86.h>
+
+#include "pci.h"
+
+#define PCI_CONF_ADDR 0xcf8
+#define PCI_CONF_DATA 0xcfc
+
+static uint32_t pci_conf_addr(uint32_t bus, uint32_t dev, uint32_t func,
+                              uint32_t off)
+{
+    return (1u << 31) | (bus << 16) | (dev << 11) | (func << 8) | (off & 0xfc);
+}
+
+static uint32_t pci_read(uint32_t bus, uint32_t dev, uint32_t func,
+                         uint32_t off)
+{
+    outl(PCI_CONF_ADDR, pci_conf_addr(bus, dev, func, off));
+    return inl(PCI_CONF_DATA);
+}
+
+uint32_t pci_conf_read(struct pci_func *f, uint32_t off)
+{
+    return pci_read(f->bus, f->dev, f->func, off);
+}
+
+void pci_conf_write(struct pci_func *f, uint32_t off, uint32_t v)
+{
+    outl(PCI_CONF_ADDR, pci_conf_addr(f->bus, f->dev, f->func, off));
+    outl(PCI_CONF_DATA, v);
+}
+
+static void pci_fill(struct pci_func *f, uint32_t bus, uint32_t dev,
+                     uint32_t func, uint32_t id)
+{
+    uint32_t class;
+    int i;
+
+    f->bus = bus;
+    f->dev = dev;
+    f->func = func;
+    f->vendor = id & 0xffff;
+    f->device = id >> 16;
+    class = pci_conf_read(f, PCI_CLASS_REG);
+    f->class = class >> 24;
+    f->subclass = (class >> 16) & 0xff;
+    f->progif = (class >> 8) & 0xff;
+    for (i = 0; i < 6; i++)
+        f->bar[i] = pci_conf_read(f, PCI_BAR_REG(i));
+    f->irq_line = pci_conf_read(f, PCI_INTR_REG) & 0xff;
+}
+
+/**
+ * Scan every function on every bus; stop at the first one for which
+ * match() returns true.
+ */
+static int pci_scan(bool (*match)(struct pci_func *, uint32_t, uint32_t),
+                    uint32_t a, uint32_t b, struct pci_func *f)
+{
+    uint32_t bus, dev, func, id, nfunc;
+
+    for (bus = 0; bus < 256; bus++) {
+        for (dev = 0; dev < 32; dev++) {
+            nfunc = 1;
+            for (func = 0; func < nfunc; func++) {
+                id = pci_read(bus, dev, func, PCI_ID_REG);
+                if ((id & 0xffff) == 0xffff)
+                    continue;
+                // Multi-function device?
+                if (func == 0 && (pci_read(bus, dev, 0, PCI_BHLC_REG) & 0x800000))
+                    nfunc = 8;
+                pci_fill(f, bus, dev, func, id);
+                if (match(f, a, b))
+                    return 0;
+            }
+        }
+    }
+    return -1;
+}
+
+static bool match_class(struct pci_func *f, uint32_t class, uint32_t subclass)
+{
+    return f->class == class && f->subclass == subclass;
+}
+
+static bool match_device(struct pci_func *f, uint32_t vendor, uint32_t device)
+{
+    return f->vendor == vendor && f->device == device;
+}
+
+int pci_find_class(uint8_t class, uint8_t subclass, struct pci_func *f)
+{
+    return pci_scan(match_class, class, subclass, f);
+}
+
+int pci_find_device(uint16_t vendor, uint16_t device, struct pci_func *f)
+{
+    return pci_scan(match_device, vendor, device, f);
+}
+
+void pci_enable(struct pci_func *f)
+{
+    uint32_t cmd = pci_conf_read(f, PCI_COMMAND_REG);
+
+    cmd |= PCI_COMMAND_IO | PCI_COMMAND_MEM | PCI_COMMAND_MASTER;
+    pci_conf_write(f, PCI_COMMAND_REG, cmd & 0xffff);
+}
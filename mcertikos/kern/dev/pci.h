@@ -0,0 +1,59 @@
+#ifndef _KERN_DEV_PCI_H_
+#define _KERN_DEV_PCI_H_
+
+#ifdef _KERN_
+
+#include <lib/types.h>
+
+// Configuration space registers
+#define PCI_ID_REG       0x00  // vendor (low 16) and device (high 16) id
+#define PCI_COMMAND_REG  0x04  // command (low 16) and status (high 16)
+#define PCI_CLASS_REG    0x08  // class, subclass, prog-if, revision
+#define PCI_BHLC_REG     0x0c  // BIST, header type, latency, cache line
+#define PCI_BAR_REG(n)   (0x10 + 4 * (n))
+#define PCI_INTR_REG     0x3c  // interrupt pin and line
+
+#define PCI_COMMAND_IO     0x1
+#define PCI_COMMAND_MEM    0x2
+#define PCI_COMMAND_MASTER 0x4
+
+#define PCI_CLASS_STORAGE   0x01
+#define PCI_SUBCLASS_IDE    0x01
+#define PCI_SUBCLASS_SATA   0x06
+
+struct pci_func {
+    uint8_t bus;
+    uint8_t dev;
+    uint8_t func;
+    uint16_t vendor;
+    uint16_t device;
+    uint8_t class;
+    uint8_t subclass;
+    uint8_t progif;
+    uint32_t bar[6];   // base address registers, as read
+    uint8_t irq_line;
+};
+
+uint32_t pci_conf_read(struct pci_func *f, uint32_t off);
+void pci_conf_write(struct pci_func *f, uint32_t off, uint32_t v);
+
+/**
+ * Find the first function with the given class and subclass.
+ * Return 0 and fill in *f, or -1 if there is none.
+ */
+int pci_find_class(uint8_t class, uint8_t subclass, struct pci_func *f);
+
+/**
+ * Find the first function with the given vendor and device id.
+ * Return 0 and fill in *f, or -1 if there is none.
+ */
+int pci_find_device(uint16_t vendor, uint16_t device, struct pci_func *f);
+
+/**
+ * Enable I/O and memory decoding and bus mastering for f.
+ */
+void pci_enable(struct pci_func *f);
+
+#endif  /* _KERN_ */
+
+#endif  /* !_KERN_DEV_PCI_H_ */
@@ -8,11 +8,46 @@
 // Initialize a flock.
 void flock_init(struct flock_t *flock);
 
-// Acquire flock on a file. 
-int flock_acquire(struct flock_t *flock, int operation);
+// Acquire flock on a file. held is the lock the caller already has
+// (LOCK_SH, LOCK_EX or 0), which is converted in place: a downgrade
+// never blocks, and an upgrade waits until the caller is the last
+// shared owner. Return -1 if another upgrade is already waiting.
+int flock_acquire(struct flock_t *flock, int operation, int held);
 
 // Release flock on a file.
 int flock_release(struct flock_t *flock);
+
+// Set the policy that decides which waiters get the lock next
+// (LOCKPOL_WRITER, LOCKPOL_READER or LOCKPOL_FIFO), or leave it alone if
+// policy is -1. Return the previous policy, or -1 if policy is invalid.
+int flock_policy(struct flock_t *flock, int policy);
+
+// Set up the allocator of byte-range lock records, once at boot.
+void rangelock_setup(void);
+
+// Initialize the byte-range locks of an inode.
+void rangelock_init(struct rangelock_t *rl);
+
+// Lock [start, end) for owner with type F_RDLCK or F_WRLCK, replacing
+// the owner's locks there. If another owner's lock conflicts, return
+// EWOULDBLOCK or, if wait is set, sleep until it goes away.
+// Return -E_INVAL for an empty range or a bad type, -E_MEM if out of
+// memory.
+int rangelock_acquire(struct rangelock_t *rl, int owner, int type,
+                      uint32_t start, uint32_t end, bool wait);
+
+// Unlock [start, end) for owner, splitting the locks that straddle it.
+// Return -E_INVAL for an empty range, -E_MEM if out of memory.
+int rangelock_release(struct rangelock_t *rl, int owner,
+                      uint32_t start, uint32_t end);
+
+// Drop all of owner's locks.
+void rangelock_release_all(struct rangelock_t *rl, int owner);
+
+// Copy a lock of another owner that would block the given request into
+// *conflict and return TRUE, or return FALSE if there is none.
+bool rangelock_test(struct rangelock_t *rl, int owner, int type,
+                    uint32_t start, uint32_t end, struct rlock *conflict);
 #endif /* _KERN_ */
 
 #endif /* !_KERN_FLOCK_H_ */
\ No newline at end of file
@@ -1,143 +1,452 @@
+#include <lib/x86.h>
+#include <lib/thread.h>
+#include <dev/tsc.h>
+#include <fs/fcntl.h>
+
 #include "flock.h"
 #include "import.h"
 
+/*
+ * Lock requests that cannot be granted at once wait in a FIFO queue,
+ * each on its own condition variable, so a release wakes exactly the
+ * threads it grants the lock to. The policy of the flock decides who
+ * goes next when it is released:
+ *
+ *  LOCKPOL_WRITER  the oldest writer, if any is waiting; readers only
+ *                  get in while no writer waits.
+ *  LOCKPOL_READER  every waiting reader, as long as no writer holds the
+ *                  lock; writers only get in while no reader waits.
+ *  LOCKPOL_FIFO    strict arrival order.
+ *
+ * Under every policy the readers let in together are granted as one
+ * batch.
+ *
+ * Most locks are only held for a moment, and putting a waiter to sleep
+ * and waking it costs more than that. So before a waiter queues up, it
+ * keeps yielding the CPU, letting the holder run, for up to twice the
+ * average time the lock is held but no more than 1/32 ms, unless the
+ * holder is asleep itself.
+ * There is only one CPU, so yielding is the closest thing to spinning
+ * that can make progress.
+ *
+ * Who holds the lock is kept in one word: the number of readers, a
+ * writer bit, and a bit saying that somebody waits. While that last bit
+ * is clear, taking and dropping the lock is a single cmpxchg on the word
+ * and flock->lock is not touched. Waiters set it to make everybody else
+ * take the slow path through flock->lock, so the queue decides who goes
+ * next.
+ */
+
+#define FLOCK_SPIN_SHIFT 5  // spin at most 1/32 ms
+
 /**
  * Initialize a flock.
 */
 void flock_init(struct flock_t *flock) {
+    flock->word = 0;
+
     flock->num_sh_waiting = 0;
     flock->num_ex_waiting = 0;
-    flock->num_sh_active = 0;
 
-    flock->ex_active = FALSE;
-    flock->sh_active = FALSE;
+    flock->upgrading = FALSE;
+    flock->policy = LOCKPOL_WRITER;
+    flock->head = NULL;
+    flock->tail = NULL;
 
-    flock->state = INACTIVE;
+    flock->owner = NUM_IDS;
+    flock->acquired = 0;
+    flock->avg_hold = 0;
 
     spinlock_init(&flock->lock);
-    cv_init(&flock->ex_flock);
-    cv_init(&flock->sh_flock);
+    cv_init(&flock->up_flock);
 }
 
-int flock_acquire(struct flock_t *flock, int operation) {
+/**
+ * Atomically set flock->word to ((word & ~clear) | set) + add. Return
+ * the new value.
+ */
+static uint32_t flock_word(struct flock_t *flock, uint32_t clear,
+                           uint32_t set, uint32_t add) {
+    uint32_t old, new;
 
-    spinlock_acquire(&flock->lock);
+    do {
+        old = flock->word;
+        new = ((old & ~clear) | set) + add;
+    } while (cmpxchg(&flock->word, old, new) != old);
+    return new;
+}
 
-    if (operation & LOCK_EX) {
+static bool flock_free(struct flock_t *flock) {
+    return (flock->word & (FLOCK_WRITER | FLOCK_READERS)) == 0;
+}
 
-        if (flock->state == INACTIVE) {
-            flock->state = EXCLUSIVE;
-            flock->ex_active = TRUE;
-            spinlock_release(&flock->lock); 
-            return 0;
-        } else if (operation & LOCK_NB) {
-            spinlock_release(&flock->lock);
-            return EWOULDBLOCK;
-        } else {
-            flock->num_ex_waiting++;
-            while (flock->num_sh_active > 0 || flock->ex_active) {
-                cv_wait(&flock->ex_flock, &flock->lock);
+static uint32_t flock_readers(struct flock_t *flock) {
+    return flock->word & FLOCK_READERS;
+}
+
+/**
+ * Keep FLOCK_WAITERS set exactly while someone is queued or upgrading.
+ * Caller holds flock->lock.
+ */
+static void flock_settle(struct flock_t *flock) {
+    bool waiters = flock->head != NULL || flock->upgrading;
+
+    if (waiters && !(flock->word & FLOCK_WAITERS)) {
+        flock_word(flock, 0, FLOCK_WAITERS, 0);
+    } else if (!waiters && (flock->word & FLOCK_WAITERS)) {
+        flock_word(flock, FLOCK_WAITERS, 0, 0);
+    }
+}
+
+static void flock_enqueue(struct flock_t *flock, struct flock_waiter *w) {
+    w->next = NULL;
+    if (flock->tail == NULL) {
+        flock->head = w;
+    } else {
+        flock->tail->next = w;
+    }
+    flock->tail = w;
+
+    if (w->type == LOCK_EX) {
+        flock->num_ex_waiting++;
+    } else {
+        flock->num_sh_waiting++;
+    }
+}
+
+/**
+ * Take w, which follows prev (NULL if w is first), off the queue.
+ */
+static void flock_dequeue(struct flock_t *flock, struct flock_waiter *prev,
+                          struct flock_waiter *w) {
+    if (prev == NULL) {
+        flock->head = w->next;
+    } else {
+        prev->next = w->next;
+    }
+    if (flock->tail == w) {
+        flock->tail = prev;
+    }
+
+    if (w->type == LOCK_EX) {
+        flock->num_ex_waiting--;
+    } else {
+        flock->num_sh_waiting--;
+    }
+}
+
+/**
+ * Hand the lock to the waiter w, which follows prev, and wake it up.
+ */
+static void flock_wake(struct flock_t *flock, struct flock_waiter *prev,
+                       struct flock_waiter *w) {
+    flock_dequeue(flock, prev, w);
+    if (flock_free(flock)) {
+        flock->acquired = rdtsc();
+    }
+    flock->owner = w->pid;
+    if (w->type == LOCK_EX) {
+        flock_word(flock, 0, FLOCK_WRITER, 0);
+    } else {
+        flock_word(flock, 0, 0, 1);
+    }
+    w->granted = TRUE;
+    cv_signal(&w->cv);
+}
+
+/**
+ * Grant the lock to as many waiters as the state and policy allow.
+ * Caller holds flock->lock.
+ */
+static void flock_grant(struct flock_t *flock) {
+    struct flock_waiter *prev, *w, *next;
+    bool readers;
+
+    // A shared owner waiting to upgrade goes before anybody else.
+    if (flock->upgrading || (flock->word & FLOCK_WRITER)) {
+        return;
+    }
+
+    if (flock->policy == LOCKPOL_FIFO) {
+        // Readers from the front of the queue, up to the first writer.
+        while ((w = flock->head) != NULL && w->type == LOCK_SH) {
+            flock_wake(flock, NULL, w);
+        }
+        if (w != NULL && flock_free(flock)) {
+            flock_wake(flock, NULL, w);
+        }
+        return;
+    }
+
+    if (flock->policy == LOCKPOL_WRITER) {
+        readers = flock->num_ex_waiting == 0;
+    } else {
+        readers = flock->num_sh_waiting > 0;
+    }
+
+    prev = NULL;
+    for (w = flock->head; w != NULL; w = next) {
+        next = w->next;
+        if (readers && w->type == LOCK_SH) {
+            flock_wake(flock, prev, w);
+        } else if (!readers && w->type == LOCK_EX) {
+            // The oldest writer, once the lock is free.
+            if (flock_free(flock)) {
+                flock_wake(flock, prev, w);
             }
-            flock->num_ex_waiting--;
-            flock->ex_active = TRUE;
-            flock->state = EXCLUSIVE;
-            spinlock_release(&flock->lock);
-            return 0; 
+            return;
+        } else {
+            prev = w;
         }
+    }
+}
+
+/**
+ * Account for a hold of the lock that just ended. The average is only a
+ * hint, so the fast path updates it without flock->lock.
+ */
+static void flock_held(struct flock_t *flock) {
+    uint64_t hold = rdtsc() - flock->acquired;
 
-    } else if (operation & LOCK_SH) {
-
-        if (flock->state == INACTIVE || flock->state == SHARED) {
-            /*
-            if (operation & LOCK_NB) {
-                spinlock_release(&flock->lock);
-                return EWOULDBLOCK; 
-            } else {
-            */
-           // prioritize exclusive (writers) so you dont get writer starvation
-            if (flock->num_ex_waiting > 0) {
-                if (operation & LOCK_NB) {
-                    spinlock_release(&flock->lock);
-                    return EWOULDBLOCK; 
-                } else {
-                    flock->num_sh_waiting++;
-                    while (flock->num_ex_waiting > 0) {
-                        cv_wait(&flock->sh_flock, &flock->lock);
-                    }
-                    flock->num_sh_waiting--;
-                }
-            } 
-            flock->state = SHARED;
-            flock->num_sh_active++;
-            flock->sh_active = TRUE;
+    // avg_hold = 7/8 avg_hold + 1/8 hold
+    flock->avg_hold += (hold >> 3) - (flock->avg_hold >> 3);
+}
+
+/**
+ * Let the holder run for a while in the hope that it frees the lock for
+ * a request of the given type, so that we need not sleep. Give up once
+ * the spin budget is spent, if the holder goes to sleep, or if someone
+ * else queues up first. Caller holds flock->lock.
+ */
+static void flock_spin(struct flock_t *flock, int type) {
+    uint64_t start, budget, limit = tsc_per_ms >> FLOCK_SPIN_SHIFT;
+
+    // Spinning does not pay off for locks held for long.
+    if (flock->avg_hold > limit) {
+        return;
+    }
+    budget = MIN(flock->avg_hold << 1, limit);
+
+    start = rdtsc();
+    while (flock->head == NULL
+           && ((flock->word & FLOCK_WRITER)
+               || (type == LOCK_EX && flock_readers(flock) > 0))
+           && (flock->owner == NUM_IDS
+               || tcb_get_state(flock->owner) != TSTATE_SLEEP)
+           && rdtsc() - start < budget) {
+        spinlock_release(&flock->lock);
+        thread_yield();
+        spinlock_acquire(&flock->lock);
+    }
+}
+
+/**
+ * Turn the caller's exclusive lock into a shared one. Caller holds
+ * flock->lock.
+ */
+static int flock_downgrade(struct flock_t *flock) {
+    flock_word(flock, FLOCK_WRITER, 0, 1);
+    // Readers queued behind us may come in now.
+    flock_grant(flock);
+    flock_settle(flock);
+    spinlock_release(&flock->lock);
+    return 0;
+}
+
+/**
+ * Turn the caller's shared lock into an exclusive one once every other
+ * shared owner is gone. The caller keeps its shared lock throughout, so
+ * no writer can get in between. Caller holds flock->lock.
+ */
+static int flock_upgrade(struct flock_t *flock, int operation) {
+    if (flock_readers(flock) > 1) {
+        // Two upgraders would wait for each other forever.
+        if (flock->upgrading) {
             spinlock_release(&flock->lock);
-            return 0;
-            
-            
-            //}
-        } else {
-            // flock->state == exclusive
-            if (operation & LOCK_NB) {
-                // TODO: implement non-blocking 
-                spinlock_release(&flock->lock);
-                return EWOULDBLOCK;
-            } else {
-                flock->num_sh_waiting++;
-                while (flock->num_ex_waiting > 0 || flock->ex_active) {
-                    cv_wait(&flock->sh_flock, &flock->lock);
-                }
-                flock->state = SHARED;
-                flock->num_sh_active++;
-                flock->sh_active = TRUE;
-                flock->num_sh_waiting--;
-                spinlock_release(&flock->lock);
-                return 0;
-            }
+            return -1;
+        }
+        if (operation & LOCK_NB) {
+            spinlock_release(&flock->lock);
+            return EWOULDBLOCK;
         }
+        // flock_grant() lets nobody in while we wait.
+        // Readers leaving through the slow path signal us.
+        flock->upgrading = TRUE;
+        flock_settle(flock);
+        while (flock_readers(flock) > 1) {
+            cv_wait(&flock->up_flock, &flock->lock);
+        }
+        flock->upgrading = FALSE;
+    }
+    flock->owner = get_curid();
+    flock_word(flock, FLOCK_READERS, FLOCK_WRITER, 0);
+    flock_settle(flock);
+    spinlock_release(&flock->lock);
+    return 0;
+}
+
+/**
+ * Take the lock with a single cmpxchg if nobody waits and it is free,
+ * or, for LOCK_SH, only read-locked. Return whether we got it.
+ */
+static bool flock_fast_acquire(struct flock_t *flock, int type) {
+    uint32_t old = flock->word;
+
+    if (type == LOCK_EX) {
+        if (old != 0 || cmpxchg(&flock->word, 0, FLOCK_WRITER) != 0) {
+            return FALSE;
+        }
+    } else {
+        if ((old & (FLOCK_WRITER | FLOCK_WAITERS))
+            || cmpxchg(&flock->word, old, old + 1) != old) {
+            return FALSE;
+        }
+    }
+
+    // Hints for flock_spin(); a race here does no harm.
+    flock->owner = get_curid();
+    if (old == 0) {
+        flock->acquired = rdtsc();
+    }
+    return TRUE;
+}
+
+/**
+ * Drop the lock with a single cmpxchg if nobody waits. Return whether
+ * we did.
+ */
+static bool flock_fast_release(struct flock_t *flock) {
+    uint32_t old = flock->word, new;
+
+    if (old == 0 || (old & FLOCK_WAITERS)) {
+        return FALSE;
+    }
+    new = (old & FLOCK_WRITER) ? 0 : old - 1;
+    if (cmpxchg(&flock->word, old, new) != old) {
+        return FALSE;
+    }
+
+    if (new == 0) {
+        flock_held(flock);
+    }
+    return TRUE;
+}
+
+int flock_acquire(struct flock_t *flock, int operation, int held) {
+    struct flock_waiter w;
+
+    w.type = (operation & LOCK_EX) ? LOCK_EX : LOCK_SH;
+    if (held == 0 && (operation & (LOCK_SH | LOCK_EX))
+        && flock_fast_acquire(flock, w.type)) {
+        return 0;
+    }
+
+    spinlock_acquire(&flock->lock);
+
+    // Conversions of a lock the caller already holds.
+    if (held == LOCK_EX && (operation & LOCK_EX)) {
+        spinlock_release(&flock->lock);
+        return 0;
+    } else if (held == LOCK_EX && (operation & LOCK_SH)) {
+        return flock_downgrade(flock);
+    } else if (held == LOCK_SH && (operation & LOCK_SH)) {
+        spinlock_release(&flock->lock);
+        return 0;
+    } else if (held == LOCK_SH && (operation & LOCK_EX)) {
+        return flock_upgrade(flock, operation);
+    }
 
+    if (!(operation & (LOCK_SH | LOCK_EX))) {
+        // none of the (required, i.e. shared or exlusive) operation bits were set
+        spinlock_release(&flock->lock);
+        return -1;
     }
 
-    // none of the (required, i.e. shared or exlusive) operation bits were set
+    w.pid = get_curid();
+    if (!(operation & LOCK_NB)) {
+        flock_spin(flock, w.type);
+    }
+
+    // Queue up and see whether the policy lets us in right away.
+    w.granted = FALSE;
+    cv_init(&w.cv);
+    flock_enqueue(flock, &w);
+    flock_settle(flock);
+    flock_grant(flock);
+
+    if (!w.granted && (operation & LOCK_NB)) {
+        struct flock_waiter *prev = NULL;
+
+        if (flock->head != &w) {
+            for (prev = flock->head; prev->next != &w; prev = prev->next)
+                /* do nothing */ ;
+        }
+        flock_dequeue(flock, prev, &w);
+        flock_settle(flock);
+        spinlock_release(&flock->lock);
+        return EWOULDBLOCK;
+    }
+
+    while (!w.granted) {
+        cv_wait(&w.cv, &flock->lock);
+    }
+    flock_settle(flock);
     spinlock_release(&flock->lock);
-    return -1;
+    return 0;
 }
 
 int flock_release(struct flock_t *flock) {
 
+    if (flock_fast_release(flock)) {
+        return 0;
+    }
+
     spinlock_acquire(&flock->lock);
 
-    if (flock->state == INACTIVE) {
+    if (flock_free(flock)) {
         spinlock_release(&flock->lock);
         return -1;
     }
 
-    if (flock->state == EXCLUSIVE) {
+    if (flock->word & FLOCK_WRITER) {
 
-        flock->ex_active = FALSE;
-        flock->state = INACTIVE;
-        if (flock->num_ex_waiting > 0) {
-            cv_signal(&flock->ex_flock);
-        } else {
-            cv_broadcast(&flock->sh_flock);
-        }
+        flock_word(flock, FLOCK_WRITER, 0, 0);
+        flock_held(flock);
 
-    } else if (flock->state == SHARED) {
+    } else {
 
-        flock->num_sh_active--;
-        if (flock->num_ex_waiting > 0) {
-            if (flock->num_sh_active == 0) {
-                flock->state = INACTIVE;
-                cv_signal(&flock->ex_flock);
-            }
-        } else {
-            if (flock->num_sh_active == 0) {
-                flock->state = INACTIVE;
-            }
-            cv_broadcast(&flock->sh_flock);
+        if ((flock_word(flock, 0, 0, -1) & FLOCK_READERS) == 0) {
+            flock_held(flock);
+        }
+        // The upgrader holds the last shared lock; it goes next.
+        if (flock->upgrading && flock_readers(flock) == 1) {
+            cv_signal(&flock->up_flock);
         }
 
     }
 
+    flock_grant(flock);
+    flock_settle(flock);
     spinlock_release(&flock->lock);
     return 0;
-}
\ No newline at end of file
+}
+
+int flock_policy(struct flock_t *flock, int policy) {
+    int old;
+
+    if (policy != -1 && policy != LOCKPOL_WRITER && policy != LOCKPOL_READER
+        && policy != LOCKPOL_FIFO) {
+        return -1;
+    }
+
+    spinlock_acquire(&flock->lock);
+    old = flock->policy;
+    if (policy != -1) {
+        flock->policy = policy;
+        // The new policy may let some waiters in.
+        flock_grant(flock);
+        flock_settle(flock);
+    }
+    spinlock_release(&flock->lock);
+    return old;
+}
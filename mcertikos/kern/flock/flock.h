@@ -11,25 +11,63 @@
 
 #define EWOULDBLOCK -2 // this needs to be negative
 
-enum flock_state {
-    INACTIVE = 0,
-    SHARED,
-    EXCLUSIVE
+// struct flock_t.word: who holds the lock
+#define FLOCK_WRITER  0x80000000  // held exclusively
+#define FLOCK_WAITERS 0x40000000  // somebody waits: no fast path
+#define FLOCK_READERS 0x3fffffff  // number of shared holders
+
+// A thread waiting in flock_acquire(), queued in arrival order.
+struct flock_waiter {
+    int type;      // LOCK_SH or LOCK_EX
+    unsigned int pid;
+    bool granted;  // set by whoever hands it the lock
+    cv_t cv;
+    struct flock_waiter *next;
 };
 
 struct flock_t {
+    // Taken and dropped with a single cmpxchg while nobody waits;
+    // otherwise only changed under lock.
+    volatile uint32_t word;
+
     int num_sh_waiting;
     int num_ex_waiting;
-    int num_sh_active;
 
-    bool ex_active;
-    bool sh_active;
+    bool upgrading;  // a shared owner is waiting to become exclusive
+    int policy;      // LOCKPOL_*: who goes next on release
+
+    unsigned int owner;  // thread that was last granted the lock
+    uint64_t acquired;   // TSC when the lock was last taken while free
+    uint64_t avg_hold;   // moving average of hold times, in TSC ticks
+
+    spinlock_t lock;
+    struct flock_waiter *head;  // oldest waiter
+    struct flock_waiter *tail;
+    cv_t up_flock;  // the upgrader waits here for the other readers
+};
+
+#define RLOCK_EOF 0xffffffff  // end of a byte-range lock that runs to EOF
+
+/*
+ * A byte-range lock on [start, end) held by one process. The locks of
+ * an inode form a treap ordered by start, where max is the largest end
+ * in the subtree, so overlap queries skip whole subtrees.
+ */
+struct rlock {
+    uint32_t start;
+    uint32_t end;
+    uint32_t max;
+    uint32_t prio;
+    int type;   // F_RDLCK or F_WRLCK
+    int owner;  // pid
+    struct rlock *left;
+    struct rlock *right;
+};
 
-    enum flock_state state; 
-    
+struct rangelock_t {
+    struct rlock *root;
     spinlock_t lock;
-    cv_t ex_flock;
-    cv_t sh_flock;
+    cv_t wait;  // F_SETLKW waiters; woken on every unlock
 };
 
 #endif /* !_KERN_FLOCK_STRUCT_H_ */
\ No newline at end of file
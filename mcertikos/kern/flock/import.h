@@ -14,6 +14,11 @@ void cv_wait(cv_t *cv, spinlock_t *lock);
 void cv_signal(cv_t *cv);
 void cv_broadcast(cv_t *cv); 
 
+/* thread API */
+unsigned int get_curid(void);
+unsigned int tcb_get_state(unsigned int pid);
+void thread_yield(void);
+
 #endif /* _KERN_ */
 
 #endif /* !_KERN_FLOCK_H_ */
\ No newline at end of file
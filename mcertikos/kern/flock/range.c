@@ -0,0 +1,335 @@
+/*
+ * POSIX-style byte-range locks (fcntl F_SETLK/F_SETLKW/F_GETLK).
+ *
+ * Each inode keeps its locks in a treap ordered by start offset and
+ * augmented with the largest end in every subtree, which makes it an
+ * interval tree: a query for locks overlapping [s, e) only descends into
+ * subtrees whose max end lies past s. A process holds at most one lock
+ * on any byte, so setting a lock first carves the range out of the
+ * owner's existing locks (splitting one that straddles it), then merges
+ * the new lock with abutting locks of the same owner and type.
+ * Different owners may overlap as long as all of them only read.
+ */
+
+#include <lib/types.h>
+#include <lib/string.h>
+#include <lib/syscall.h>
+#include <lib/x86.h>
+#include <pmm/MATOp/export.h>
+#include <fs/fcntl.h>
+
+#include "flock.h"
+#include "import.h"
+
+#define NRLOCKPERPAGE (PAGESIZE / sizeof(struct rlock))
+
+// Lock records are carved out of pages allocated on demand and are
+// never freed; unused ones are kept on a free list through right.
+static struct {
+    spinlock_t lock;
+    struct rlock *free;
+    uint32_t seed;  // treap priorities
+} rpool;
+
+void rangelock_setup(void)
+{
+    spinlock_init(&rpool.lock);
+    rpool.seed = 2463534242u;
+}
+
+static struct rlock *rlock_alloc(void)
+{
+    struct rlock *r;
+    unsigned int pi;
+    int i;
+
+    spinlock_acquire(&rpool.lock);
+    if (rpool.free == NULL) {
+        if ((pi = palloc()) == 0) {
+            spinlock_release(&rpool.lock);
+            return NULL;
+        }
+        r = (struct rlock *) (pi * PAGESIZE);
+        for (i = 0; i < NRLOCKPERPAGE; i++) {
+            r[i].right = rpool.free;
+            rpool.free = &r[i];
+        }
+    }
+    r = rpool.free;
+    rpool.free = r->right;
+
+    // xorshift32
+    rpool.seed ^= rpool.seed << 13;
+    rpool.seed ^= rpool.seed >> 17;
+    rpool.seed ^= rpool.seed << 5;
+    r->prio = rpool.seed;
+    spinlock_release(&rpool.lock);
+
+    r->left = r->right = NULL;
+    return r;
+}
+
+static void rlock_free(struct rlock *r)
+{
+    spinlock_acquire(&rpool.lock);
+    r->right = rpool.free;
+    rpool.free = r;
+    spinlock_release(&rpool.lock);
+}
+
+/*
+ * Treap primitives. Ties on start are broken by address so that every
+ * node has a unique position.
+ */
+
+static bool rl_before(struct rlock *a, struct rlock *b)
+{
+    return a->start < b->start || (a->start == b->start && a < b);
+}
+
+static void rl_update(struct rlock *t)
+{
+    t->max = t->end;
+    if (t->left != NULL && t->left->max > t->max)
+        t->max = t->left->max;
+    if (t->right != NULL && t->right->max > t->max)
+        t->max = t->right->max;
+}
+
+static struct rlock *rl_rotate_right(struct rlock *t)
+{
+    struct rlock *l = t->left;
+
+    t->left = l->right;
+    l->right = t;
+    rl_update(t);
+    rl_update(l);
+    return l;
+}
+
+static struct rlock *rl_rotate_left(struct rlock *t)
+{
+    struct rlock *r = t->right;
+
+    t->right = r->left;
+    r->left = t;
+    rl_update(t);
+    rl_update(r);
+    return r;
+}
+
+static struct rlock *rl_insert(struct rlock *t, struct rlock *n)
+{
+    if (t == NULL) {
+        n->left = n->right = NULL;
+        rl_update(n);
+        return n;
+    }
+    if (rl_before(n, t)) {
+        t->left = rl_insert(t->left, n);
+        if (t->left->prio > t->prio)
+            return rl_rotate_right(t);
+    } else {
+        t->right = rl_insert(t->right, n);
+        if (t->right->prio > t->prio)
+            return rl_rotate_left(t);
+    }
+    rl_update(t);
+    return t;
+}
+
+// Join two treaps where every node of a comes before every node of b.
+static struct rlock *rl_join(struct rlock *a, struct rlock *b)
+{
+    if (a == NULL)
+        return b;
+    if (b == NULL)
+        return a;
+    if (a->prio > b->prio) {
+        a->right = rl_join(a->right, b);
+        rl_update(a);
+        return a;
+    }
+    b->left = rl_join(a, b->left);
+    rl_update(b);
+    return b;
+}
+
+static struct rlock *rl_remove(struct rlock *t, struct rlock *n)
+{
+    if (t == n)
+        return rl_join(t->left, t->right);
+    if (rl_before(n, t))
+        t->left = rl_remove(t->left, n);
+    else
+        t->right = rl_remove(t->right, n);
+    rl_update(t);
+    return t;
+}
+
+/**
+ * Find the lowest lock overlapping [s, e) that belongs to owner (if mine
+ * is set) or that conflicts with a lock of the given type by owner (if
+ * mine is not set).
+ */
+static struct rlock *rl_find(struct rlock *t, uint32_t s, uint32_t e,
+                             int owner, int type, bool mine)
+{
+    struct rlock *r;
+
+    if (t == NULL || t->max <= s)
+        return NULL;
+    if ((r = rl_find(t->left, s, e, owner, type, mine)) != NULL)
+        return r;
+    if (t->start >= e)
+        return NULL;
+    if (s < t->end) {
+        if (mine ? t->owner == owner
+            : t->owner != owner && (t->type == F_WRLCK || type == F_WRLCK))
+            return t;
+    }
+    return rl_find(t->right, s, e, owner, type, mine);
+}
+
+/**
+ * Remove [s, e) from owner's locks. spare is used if a lock has to be
+ * split in two; return it if it was not needed. Caller holds rl->lock.
+ */
+static struct rlock *rl_clear(struct rangelock_t *rl, int owner,
+                              uint32_t s, uint32_t e, struct rlock *spare)
+{
+    struct rlock *r;
+
+    while ((r = rl_find(rl->root, s, e, owner, 0, TRUE)) != NULL) {
+        rl->root = rl_remove(rl->root, r);
+        if (r->start < s && e < r->end) {
+            *spare = *r;
+            spare->start = e;
+            rl->root = rl_insert(rl->root, spare);
+            spare = NULL;
+            r->end = s;
+        } else if (r->start < s) {
+            r->end = s;
+        } else if (e < r->end) {
+            r->start = e;
+        } else {
+            rlock_free(r);
+            continue;
+        }
+        rl->root = rl_insert(rl->root, r);
+    }
+    return spare;
+}
+
+void rangelock_init(struct rangelock_t *rl)
+{
+    rl->root = NULL;
+    spinlock_init(&rl->lock);
+    cv_init(&rl->wait);
+}
+
+int rangelock_acquire(struct rangelock_t *rl, int owner, int type,
+                      uint32_t start, uint32_t end, bool wait)
+{
+    struct rlock *n, *spare, *r;
+
+    if (start >= end || (type != F_RDLCK && type != F_WRLCK))
+        return -E_INVAL;
+    // Allocate up front so the tree is never left half updated.
+    if ((n = rlock_alloc()) == NULL)
+        return -E_MEM;
+    if ((spare = rlock_alloc()) == NULL) {
+        rlock_free(n);
+        return -E_MEM;
+    }
+
+    spinlock_acquire(&rl->lock);
+
+    while (rl_find(rl->root, start, end, owner, type, FALSE) != NULL) {
+        if (!wait) {
+            spinlock_release(&rl->lock);
+            rlock_free(n);
+            rlock_free(spare);
+            return EWOULDBLOCK;
+        }
+        cv_wait(&rl->wait, &rl->lock);
+    }
+
+    spare = rl_clear(rl, owner, start, end, spare);
+
+    // Absorb abutting locks of the same owner and type.
+    if (start > 0 && (r = rl_find(rl->root, start - 1, start, owner, 0, TRUE))
+        != NULL && r->type == type) {
+        rl->root = rl_remove(rl->root, r);
+        start = r->start;
+        rlock_free(r);
+    }
+    if (end != RLOCK_EOF && (r = rl_find(rl->root, end, end + 1, owner, 0, TRUE))
+        != NULL && r->type == type) {
+        rl->root = rl_remove(rl->root, r);
+        end = r->end;
+        rlock_free(r);
+    }
+
+    n->start = start;
+    n->end = end;
+    n->type = type;
+    n->owner = owner;
+    rl->root = rl_insert(rl->root, n);
+
+    // A downgrade from F_WRLCK may let readers in.
+    cv_broadcast(&rl->wait);
+    spinlock_release(&rl->lock);
+
+    if (spare != NULL)
+        rlock_free(spare);
+    return 0;
+}
+
+int rangelock_release(struct rangelock_t *rl, int owner,
+                      uint32_t start, uint32_t end)
+{
+    struct rlock *spare;
+
+    if (start >= end)
+        return -E_INVAL;
+    if ((spare = rlock_alloc()) == NULL)
+        return -E_MEM;
+
+    spinlock_acquire(&rl->lock);
+    spare = rl_clear(rl, owner, start, end, spare);
+    cv_broadcast(&rl->wait);
+    spinlock_release(&rl->lock);
+
+    if (spare != NULL)
+        rlock_free(spare);
+    return 0;
+}
+
+void rangelock_release_all(struct rangelock_t *rl, int owner)
+{
+    struct rlock *r;
+    bool any = FALSE;
+
+    spinlock_acquire(&rl->lock);
+    while ((r = rl_find(rl->root, 0, RLOCK_EOF, owner, 0, TRUE)) != NULL) {
+        rl->root = rl_remove(rl->root, r);
+        rlock_free(r);
+        any = TRUE;
+    }
+    if (any)
+        cv_broadcast(&rl->wait);
+    spinlock_release(&rl->lock);
+}
+
+bool rangelock_test(struct rangelock_t *rl, int owner, int type,
+                    uint32_t start, uint32_t end, struct rlock *conflict)
+{
+    struct rlock *r;
+
+    spinlock_acquire(&rl->lock);
+    if ((r = rl_find(rl->root, start, end, owner, type, FALSE)) != NULL)
+        *conflict = *r;
+    spinlock_release(&rl->lock);
+    return r != NULL;
+}
@@ -21,8 +21,9 @@ void block_zero(uint32_t dev, uint32_t bno)
 {
     struct buf *bp;
 
-    bp = bufcache_read(dev, bno);
+    bp = bufcache_getblk(dev, bno);  // no need to read what we zero
     memset(bp->data, 0, BSIZE);
+    bp->flags |= B_VALID;
     log_write(bp);
     bufcache_release(bp);
 }
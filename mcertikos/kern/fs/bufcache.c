@@ -19,13 +19,19 @@
 // * B_VALID: the buffer data has been read from the disk.
 // * B_DIRTY: the buffer data has been modified
 //            and needs to be written to disk.
+//
+// bufcache_prefetch() claims a buffer B_BUSY and hands it to the
+// read-ahead thread, which reads it and releases it, so the caller does
+// not wait for the disk and readers of the block wait for that read.
 
 #include <kern/lib/types.h>
 #include <kern/lib/debug.h>
 #include <kern/lib/spinlock.h>
 #include <kern/lib/buf.h>
+#include <kern/lib/x86.h>
 #include <thread/PThread/export.h>
-#include <dev/disk/ide.h>
+#include <dev/disk/disk.h>
+#include <dev/disk/diskstat.h>
 #include "params.h"
 
 struct {
@@ -35,8 +41,16 @@ struct {
     // Linked list of all buffers, through prev/next.
     // head.next is most recently used.
     struct buf head;
+
+    // Bufs claimed by bufcache_prefetch() for the read-ahead thread,
+    // B_BUSY until it has read them. Free-running indices.
+    struct buf *ra[NPREFETCH];
+    uint32_t ra_head;
+    uint32_t ra_tail;
 } bcache;
 
+static void bufcache_readahead(void);
+
 void bufcache_init(void)
 {
     struct buf *b;
@@ -53,6 +67,10 @@ void bufcache_init(void)
         bcache.head.next->prev = b;
         bcache.head.next = b;
     }
+
+    bcache.ra_head = bcache.ra_tail = 0;
+    if (thread_spawn(bufcache_readahead, 0, 0) == NUM_IDS)
+        KERN_PANIC("bufcache_init: cannot create the read-ahead thread");
 }
 
 /**
@@ -102,12 +120,58 @@ struct buf *bufcache_read(uint32_t dev, uint32_t sector)
     struct buf *b;
 
     b = bufcache_get(dev, sector);
+    diskstat_cache(dev, (b->flags & B_VALID) != 0);
     if (!(b->flags & B_VALID)) {
-        ide_rw(b);
+        disk_rw(b);
+        if (b->flags & B_ERROR)
+            KERN_PANIC("bread: I/O error at sector %d", sector);
     }
     return b;
 }
 
+/**
+ * Return a B_BUSY buf for the indicated disk sector without reading it.
+ * The caller overwrites the whole block, so the old contents are not needed.
+ */
+struct buf *bufcache_getblk(uint32_t dev, uint32_t sector)
+{
+    return bufcache_get(dev, sector);
+}
+
+struct buf *bufcache_lookup(uint32_t dev, uint32_t sector)
+{
+    struct buf *b;
+
+    spinlock_acquire(&bcache.lock);
+
+loop:
+    for (b = bcache.head.next; b != &bcache.head; b = b->next) {
+        if (b->dev == dev && b->sector == sector) {
+            if (b->flags & B_BUSY) {
+                thread_sleep(b, &bcache.lock);
+                goto loop;
+            }
+            if (!(b->flags & B_VALID))
+                break;
+            b->flags |= B_BUSY;
+            spinlock_release(&bcache.lock);
+            return b;
+        }
+    }
+    spinlock_release(&bcache.lock);
+    return NULL;
+}
+
+int bufcache_direct(struct buf *b, uint32_t dev, uint32_t sector, bool write)
+{
+    b->dev = dev;
+    b->sector = sector;
+    b->flags = B_BUSY | (write ? B_VALID | B_DIRTY : 0);
+    b->prev = b->next = b->qnext = NULL;
+    disk_rw(b);
+    return (b->flags & B_ERROR) ? -1 : 0;
+}
+
 /**
  * Write b's contents to disk. Must be B_BUSY.
  */
@@ -117,7 +181,9 @@ void bufcache_write(struct buf *b)
         KERN_PANIC("bwrite");
 
     b->flags |= B_DIRTY;
-    ide_rw(b);
+    disk_rw(b);
+    if (b->flags & B_ERROR)
+        KERN_PANIC("bwrite: I/O error at sector %d", b->sector);
 }
 
 /**
@@ -143,3 +209,102 @@ void bufcache_release(struct buf *b)
 
     spinlock_release(&bcache.lock);
 }
+
+// Move b to the LRU end of the list. Caller holds bcache.lock.
+static void bufcache_make_cold(struct buf *b)
+{
+    b->next->prev = b->prev;
+    b->prev->next = b->next;
+    b->prev = bcache.head.prev;
+    b->next = &bcache.head;
+    bcache.head.prev->next = b;
+    bcache.head.prev = b;
+}
+
+void bufcache_release_cold(struct buf *b)
+{
+    if ((b->flags & B_BUSY) == 0)
+        KERN_PANIC("brelse");
+
+    spinlock_acquire(&bcache.lock);
+    bufcache_make_cold(b);
+    b->flags &= ~B_BUSY;
+    thread_wakeup(b);
+    spinlock_release(&bcache.lock);
+}
+
+/**
+ * Body of the read-ahead thread: read the bufs bufcache_prefetch()
+ * queued, one by one, and release them, which wakes anyone who wanted
+ * them in the meantime.
+ */
+static void bufcache_readahead(void)
+{
+    struct buf *b;
+
+    spinlock_acquire(&bcache.lock);
+    while (1) {
+        while (bcache.ra_head == bcache.ra_tail)
+            thread_sleep(&bcache.ra, &bcache.lock);
+        b = bcache.ra[bcache.ra_head++ % NPREFETCH];
+        spinlock_release(&bcache.lock);
+
+        disk_rw(b);  // on error the buf stays invalid and is read again
+        bufcache_release(b);
+
+        spinlock_acquire(&bcache.lock);
+    }
+}
+
+void bufcache_prefetch(uint32_t dev, uint32_t sector)
+{
+    struct buf *b, *victim = NULL;
+
+    spinlock_acquire(&bcache.lock);
+    if (bcache.ra_tail - bcache.ra_head == NPREFETCH)
+        goto out;  // the read-ahead thread is behind; it is only a hint
+    for (b = bcache.head.next; b != &bcache.head; b = b->next) {
+        if (b->dev == dev && b->sector == sector) {
+            // A dropped buf keeps its dev and sector but holds nothing.
+            if (b->flags & (B_VALID | B_BUSY))
+                goto out;  // cached or being read already
+            victim = b;
+            break;
+        }
+    }
+    for (b = bcache.head.prev; victim == NULL && b != &bcache.head;
+         b = b->prev) {
+        if ((b->flags & (B_BUSY | B_DIRTY)) == 0)
+            victim = b;
+    }
+    if (victim == NULL)
+        goto out;
+
+    // Claim the buf now, so readers of the sector wait for it instead
+    // of reading it a second time, and leave the reading to the thread.
+    victim->dev = dev;
+    victim->sector = sector;
+    victim->flags = B_BUSY;
+    bcache.ra[bcache.ra_tail++ % NPREFETCH] = victim;
+    thread_wakeup(&bcache.ra);
+out:
+    spinlock_release(&bcache.lock);
+}
+
+void bufcache_drop(uint32_t dev, uint32_t sector)
+{
+    struct buf *b;
+
+    spinlock_acquire(&bcache.lock);
+    for (b = bcache.head.next; b != &bcache.head; b = b->next) {
+        if (b->dev == dev && b->sector == sector) {
+            // Busy or dirty buffers are in use; leave them alone.
+            if ((b->flags & (B_BUSY | B_DIRTY)) == 0) {
+                b->flags &= ~B_VALID;
+                bufcache_make_cold(b);
+            }
+            break;
+        }
+    }
+    spinlock_release(&bcache.lock);
+}
@@ -35,6 +35,26 @@ void bufcache_init(void);
  */
 struct buf *bufcache_read(uint32_t dev, uint32_t sector);
 
+/**
+ * Return a B_BUSY buf for the indicated disk sector without reading it
+ * from disk. For callers that overwrite the whole block: they must fill
+ * b->data completely and then set B_VALID.
+ */
+struct buf *bufcache_getblk(uint32_t dev, uint32_t sector);
+
+/**
+ * Return the B_BUSY cached buf for the indicated disk sector,
+ * or NULL if the sector is not cached. Never reads the disk.
+ */
+struct buf *bufcache_lookup(uint32_t dev, uint32_t sector);
+
+/**
+ * Read or write one sector through b, a buf owned by the caller that is
+ * not part of the cache. Used for O_DIRECT I/O; the caller keeps any
+ * cached copy of the sector consistent. Returns -1 on an I/O error.
+ */
+int bufcache_direct(struct buf *b, uint32_t dev, uint32_t sector, bool write);
+
 /**
  * Write b's contents to disk.  Must be B_BUSY.
  */
@@ -46,6 +66,26 @@ void bufcache_write(struct buf *b);
  */
 void bufcache_release(struct buf *b);
 
+/**
+ * Release a B_BUSY buffer that is unlikely to be used again.
+ * Move it to the LRU end so that it is recycled first.
+ */
+void bufcache_release_cold(struct buf *b);
+
+/**
+ * Start bringing the indicated sector into the cache if it is not there
+ * yet, without waiting: the buffer is claimed B_BUSY and read by the
+ * read-ahead thread. Does nothing if no buffer is free or NPREFETCH
+ * reads are already pending.
+ */
+void bufcache_prefetch(uint32_t dev, uint32_t sector);
+
+/**
+ * Forget the cached copy of the indicated sector, if it is clean and
+ * not in use, and make its buffer the first to be recycled.
+ */
+void bufcache_drop(uint32_t dev, uint32_t sector);
+
 #endif  /* _KERN_ */
 
 #endif  /* !_KERN_FS_BUFCACHE_H_ */
@@ -1,14 +1,95 @@
 #include <kern/lib/types.h>
 #include <kern/lib/debug.h>
+#include <kern/lib/gcc.h>
 #include <kern/lib/string.h>
+#include "bufcache.h"
 #include "inode.h"
 #include "dir.h"
+#include "log.h"
 
 // Directories
 
+/**
+ * Directory entry names are compared a word at a time.
+ * A key is a name zero-padded to DIRSIZ bytes, which is exactly how
+ * dir_link() (and mkfs) store names on disk, so an on-disk name matches
+ * a key iff all DIRSIZ bytes are equal and no NUL has to be searched for.
+ */
+typedef uint32_t dir_word_t __attribute__((may_alias, aligned(1)));
+typedef uint16_t dir_half_t __attribute__((may_alias, aligned(1)));
+
+union dir_key {
+    char name[DIRSIZ];
+    struct {
+        uint32_t w[3];
+        uint16_t h;
+    } v;
+};
+
+static void dir_namekey(union dir_key *key, const char *name)
+{
+    strncpy(key->name, name, DIRSIZ);  // strncpy zero-pads the rest
+}
+
+/**
+ * Compare an on-disk (zero-padded) name against a key.
+ * Return 0 if they are equal.
+ */
+static gcc_inline uint32_t dir_keycmp(const char *name, const union dir_key *key)
+{
+    const dir_word_t *w = (const dir_word_t *) name;
+    const dir_half_t *h = (const dir_half_t *) (name + 12);
+
+    return (w[0] ^ key->v.w[0]) | (w[1] ^ key->v.w[1])
+        | (w[2] ^ key->v.w[2]) | (uint32_t) (*h ^ key->v.h);
+}
+
 int dir_namecmp(const char *s, const char *t)
 {
-    return strncmp(s, t, DIRSIZ);
+    union dir_key ks, kt;
+
+    dir_namekey(&ks, s);
+    dir_namekey(&kt, t);
+    return dir_keycmp(ks.name, &kt) != 0;
+}
+
+void dir_iter_init(struct dir_iter *it, struct inode *dp, uint32_t off)
+{
+    it->dp = dp;
+    it->bp = NULL;
+    it->bn = 0;
+    it->off = off;
+}
+
+struct dirent *dir_iter_next(struct dir_iter *it, uint32_t *poff)
+{
+    uint32_t off = it->off;
+
+    if (off + sizeof(struct dirent) > it->dp->size) {
+        dir_iter_done(it);
+        return NULL;
+    }
+
+    // Move on to the block holding off. Entries never straddle blocks.
+    if (it->bp == NULL || it->bn != off / BSIZE) {
+        dir_iter_done(it);
+        it->bn = off / BSIZE;
+        it->bp = inode_block_read(it->dp, it->bn);
+    }
+
+    it->off = off + sizeof(struct dirent);
+    if (poff != NULL) {
+        *poff = off;
+    }
+    return (struct dirent *) (it->bp->data + off % BSIZE);
+}
+
+void dir_iter_done(struct dir_iter *it)
+{
+    if (it->bp != NULL) {
+        bufcache_release(it->bp);
+        it->bp = NULL;
+    }
 }
 
 /**
@@ -17,19 +98,24 @@ int dir_namecmp(const char *s, const char *t)
  */
 struct inode *dir_lookup(struct inode *dp, char *name, uint32_t * poff)
 {
-    uint32_t off;
-    struct dirent de;
+    uint32_t off, inum;
+    struct dir_iter it;
+    struct dirent *de;
+    union dir_key key;
 
     if (dp->type != T_DIR)
         KERN_PANIC("dir_lookup not DIR");
 
-    for (off = 0; off < dp->size; off += sizeof(struct dirent)) {
-        KERN_ASSERT(inode_read(dp, (char *) &de, off, sizeof(struct dirent)) == sizeof(struct dirent));
-        if (dir_namecmp(de.name, name) == 0 && de.inum != 0) {
+    dir_namekey(&key, name);
+    dir_iter_init(&it, dp, 0);
+    while ((de = dir_iter_next(&it, &off)) != NULL) {
+        if (de->inum != 0 && dir_keycmp(de->name, &key) == 0) {
+            inum = de->inum;
+            dir_iter_done(&it);
             if (poff != NULL) {
                 *poff = off;
             }
-            return inode_get(dp->dev, de.inum);
+            return inode_get(dp->dev, inum);
         }
     }
 
@@ -39,26 +125,40 @@ struct inode *dir_lookup(struct inode *dp, char *name, uint32_t * poff)
 // Write a new directory entry (name, inum) into the directory dp.
 int dir_link(struct inode *dp, char *name, uint32_t inum)
 {
-    uint32_t off;
-    struct inode *tmp;
-    struct dirent de;
-
-    // Check that name is not present.
-    if ((tmp = dir_lookup(dp, name, &off)) != NULL) {
-        inode_put(tmp);
-        return -1;
-    }
+    uint32_t off, empty;
+    struct dir_iter it;
+    struct dirent *de, nde;
+    union dir_key key;
+
+    dir_namekey(&key, name);
 
-    // Look for an empty dirent.
-    for (off = 0; off < dp->size; off += sizeof(struct dirent)) {
-        KERN_ASSERT(inode_read(dp, (char *) &de, off, sizeof(struct dirent)) == sizeof(struct dirent));
-        if (de.inum == 0) {
-            break;
+    // Check that name is not present, and look for an empty dirent
+    // in the same pass.
+    empty = dp->size;
+    dir_iter_init(&it, dp, 0);
+    while ((de = dir_iter_next(&it, &off)) != NULL) {
+        if (de->inum == 0) {
+            if (empty == dp->size)
+                empty = off;
+        } else if (dir_keycmp(de->name, &key) == 0) {
+            dir_iter_done(&it);
+            return -1;
         }
     }
 
-    de.inum = inum;
-    strncpy(de.name, name, DIRSIZ);
-    KERN_ASSERT(inode_write(dp, (char *) &de, off, sizeof(struct dirent)) == sizeof(struct dirent));
+    if (empty < dp->size) {
+        // Reuse the free slot in place.
+        dir_iter_init(&it, dp, empty);
+        de = dir_iter_next(&it, NULL);
+        de->inum = inum;
+        memmove(de->name, key.name, DIRSIZ);
+        log_write(it.bp);
+        dir_iter_done(&it);
+        return 0;
+    }
+
+    nde.inum = inum;
+    memmove(nde.name, key.name, DIRSIZ);
+    KERN_ASSERT(inode_write(dp, (char *) &nde, empty, sizeof(struct dirent)) == sizeof(struct dirent));
     return 0;
 }
@@ -11,6 +11,42 @@ struct dirent {
     char name[DIRSIZ];
 };
 
+/**
+ * Directory iterator.
+ *
+ * Walks the entries of a locked directory a block at a time: the block
+ * holding the current entry stays pinned (B_BUSY) in the buffer cache and
+ * entries are returned in place, so a 512-byte block costs one buffer
+ * cache lookup instead of one inode_read() per entry.
+ *
+ * Typical use:
+ *   dir_iter_init(&it, dp, 0);
+ *   while ((de = dir_iter_next(&it, &off)) != NULL) {
+ *       ... examine (or modify, then log_write(it.bp)) *de ...
+ *   }
+ *   dir_iter_done(&it);
+ */
+struct dir_iter {
+    struct inode *dp;
+    struct buf *bp;  // pinned block holding the last returned entry
+    uint32_t bn;     // block number of bp within dp
+    uint32_t off;    // byte offset of the next entry
+};
+
+void dir_iter_init(struct dir_iter *it, struct inode *dp, uint32_t off);
+
+/**
+ * Return the next entry (including free ones) and set *poff to its byte
+ * offset, or return NULL at the end of the directory.
+ * The entry is only valid until the next call.
+ */
+struct dirent *dir_iter_next(struct dir_iter *it, uint32_t *poff);
+
+/**
+ * Release the pinned block, if any.
+ */
+void dir_iter_done(struct dir_iter *it);
+
 int dir_namecmp(const char *s, const char *t);
 
 /**
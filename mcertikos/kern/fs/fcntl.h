@@ -7,6 +7,48 @@
 #define O_WRONLY 0x001
 #define O_RDWR   0x002
 #define O_CREATE 0x200
+#define O_NOSYNC 0x400  // writes are durable only after fsync
+#define O_DIRECT 0x800  // sector-aligned I/O bypasses the buffer cache
+
+// fadvise() hints
+#define FADV_NORMAL     0  // no particular pattern
+#define FADV_RANDOM     1  // random access: no read-ahead
+#define FADV_SEQUENTIAL 2  // read-ahead, recycle consumed blocks early
+#define FADV_WILLNEED   3  // read the range into the cache now
+#define FADV_DONTNEED   4  // drop the range from the cache
+#define FADV_NOREUSE    5  // data is read once: recycle blocks early
+
+// fcntl() byte-range lock commands
+#define F_GETLK  5  // find a lock that would block the given one
+#define F_SETLK  6  // set or clear a lock, failing if it is blocked
+#define F_SETLKW 7  // set or clear a lock, waiting if it is blocked
+
+// fcntl() commands for the queueing policy of flock() on a file
+#define F_GETLKPOL 8  // return the policy
+#define F_SETLKPOL 9  // set the policy, returning the old one
+
+#define LOCKPOL_WRITER 0  // waiting writers go first (default)
+#define LOCKPOL_READER 1  // waiting readers go first
+#define LOCKPOL_FIFO   2  // arrival order; adjacent readers go together
+
+#define F_RDLCK 0
+#define F_WRLCK 1
+#define F_UNLCK 2
+
+#define SEEK_SET 0
+#define SEEK_CUR 1
+#define SEEK_END 2
+
+#include <kern/lib/types.h>
+
+// A byte-range lock request, as passed to fcntl()
+struct flock {
+    int16_t l_type;    // F_RDLCK, F_WRLCK or F_UNLCK
+    int16_t l_whence;  // SEEK_SET, SEEK_CUR or SEEK_END
+    int32_t l_start;   // relative to l_whence
+    uint32_t l_len;    // 0 means up to the end of the file
+    int32_t l_pid;     // owner of a conflicting lock (F_GETLK)
+};
 
 #endif  /* _KERN_ */
 
@@ -0,0 +1,190 @@
+// Per-process file descriptor tables. See fdtable.h.
+
+#include <kern/lib/types.h>
+#include <kern/lib/debug.h>
+#include <kern/lib/string.h>
+#include <kern/lib/spinlock.h>
+#include <kern/lib/x86.h>
+#include <pmm/MATOp/export.h>
+#include "file.h"
+#include "fdtable.h"
+
+// One page of descriptors: the open files and a bitmap of the
+// slots in use, sized to fill a page exactly.
+#define FDPERPAGE 992
+
+struct fdpage {
+    struct file *file[FDPERPAGE];
+    uint32_t used[FDPERPAGE / 32];
+    uint32_t nused;
+};
+
+struct fdtable {
+    struct fdpage *page[NFDPAGE];
+    uint32_t full;  // bit i set if page[i] has no free slot
+};
+
+struct {
+    spinlock_t lock;
+    struct fdtable table[NUM_IDS];
+} fdtables;
+
+void fdtable_init(void)
+{
+    if (sizeof(struct fdpage) != PAGESIZE)
+        KERN_PANIC("fdtable_init: bad fdpage size");
+    spinlock_init(&fdtables.lock);
+}
+
+static struct fdpage *fdpage_alloc(void)
+{
+    unsigned int pi;
+    struct fdpage *pg;
+
+    if ((pi = palloc()) == 0)
+        return NULL;
+    pg = (struct fdpage *) (pi * PAGESIZE);
+    memset(pg, 0, PAGESIZE);
+    return pg;
+}
+
+static void fdpage_free(struct fdpage *pg)
+{
+    pfree((uintptr_t) pg / PAGESIZE);
+}
+
+/**
+ * Return the page holding fd, or NULL. Caller holds the lock.
+ */
+static struct fdpage *fd_page(uint32_t pid, int fd)
+{
+    if (pid >= NUM_IDS || fd < 0 || fd >= NFDPAGE * FDPERPAGE)
+        return NULL;
+    return fdtables.table[pid].page[fd / FDPERPAGE];
+}
+
+struct file *fd_get(uint32_t pid, int fd)
+{
+    struct fdpage *pg;
+    struct file *f = NULL;
+
+    spinlock_acquire(&fdtables.lock);
+    if ((pg = fd_page(pid, fd)) != NULL)
+        f = pg->file[fd % FDPERPAGE];
+    spinlock_release(&fdtables.lock);
+    return f;
+}
+
+int fd_alloc(uint32_t pid, struct file *f)
+{
+    struct fdtable *t;
+    struct fdpage *pg;
+    int p, w, b;
+
+    if (pid >= NUM_IDS)
+        return -1;
+    t = &fdtables.table[pid];
+
+    spinlock_acquire(&fdtables.lock);
+    for (p = 0; p < NFDPAGE; p++) {
+        if (t->full & (1 << p))
+            continue;
+        if (t->page[p] == NULL) {
+            // Growing the table; palloc() does not sleep.
+            if ((t->page[p] = fdpage_alloc()) == NULL)
+                break;
+        }
+        pg = t->page[p];
+        for (w = 0; pg->used[w] == 0xffffffff; w++)
+            ;
+        for (b = 0; pg->used[w] & (1U << b); b++)
+            ;
+        pg->used[w] |= 1U << b;
+        pg->file[w * 32 + b] = f;
+        if (++pg->nused == FDPERPAGE)
+            t->full |= 1 << p;
+        spinlock_release(&fdtables.lock);
+        return p * FDPERPAGE + w * 32 + b;
+    }
+    spinlock_release(&fdtables.lock);
+    return -1;
+}
+
+struct file *fd_free(uint32_t pid, int fd)
+{
+    struct fdpage *pg;
+    struct file *f;
+    int i;
+
+    spinlock_acquire(&fdtables.lock);
+    if ((pg = fd_page(pid, fd)) == NULL
+        || (f = pg->file[i = fd % FDPERPAGE]) == NULL) {
+        spinlock_release(&fdtables.lock);
+        return NULL;
+    }
+    pg->file[i] = NULL;
+    pg->used[i / 32] &= ~(1U << (i % 32));
+    pg->nused--;
+    fdtables.table[pid].full &= ~(1 << (fd / FDPERPAGE));
+    spinlock_release(&fdtables.lock);
+    return f;
+}
+
+int fd_copy(uint32_t parent, uint32_t child)
+{
+    struct fdtable *from, *to;
+    int p, i;
+
+    if (parent >= NUM_IDS || child >= NUM_IDS)
+        return -1;
+    from = &fdtables.table[parent];
+    to = &fdtables.table[child];
+
+    spinlock_acquire(&fdtables.lock);
+    for (p = 0; p < NFDPAGE; p++) {
+        if (from->page[p] == NULL)
+            continue;
+        if ((to->page[p] = fdpage_alloc()) == NULL) {
+            spinlock_release(&fdtables.lock);
+            fd_closeall(child);
+            return -1;
+        }
+        memcpy(to->page[p], from->page[p], PAGESIZE);
+        for (i = 0; i < FDPERPAGE; i++) {
+            if (to->page[p]->file[i] != NULL)
+                file_dup(to->page[p]->file[i]);
+        }
+    }
+    to->full = from->full;
+    spinlock_release(&fdtables.lock);
+    return 0;
+}
+
+void fd_closeall(uint32_t pid)
+{
+    struct fdtable *t;
+    struct fdpage *pg;
+    int p, i;
+
+    if (pid >= NUM_IDS)
+        return;
+    t = &fdtables.table[pid];
+
+    // file_close() may sleep, so take each page out of the table first.
+    for (p = 0; p < NFDPAGE; p++) {
+        spinlock_acquire(&fdtables.lock);
+        pg = t->page[p];
+        t->page[p] = NULL;
+        spinlock_release(&fdtables.lock);
+        if (pg == NULL)
+            continue;
+        for (i = 0; i < FDPERPAGE; i++) {
+            if (pg->file[i] != NULL)
+                file_close(pg->file[i]);
+        }
+        fdpage_free(pg);
+    }
+    spinlock_acquire(&fdtables.lock);
+    t->full = 0;
+    spinlock_release(&fdtables.lock);
+}
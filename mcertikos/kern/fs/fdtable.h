@@ -0,0 +1,36 @@
+// Per-process file descriptor tables.
+//
+// A process's table starts empty and grows a page at a time, up to
+// NFDPAGE pages of FDPERPAGE descriptors each. Every page has a bitmap
+// of the descriptors in use, and the table has a mask of full pages,
+// so the lowest free descriptor is found without scanning the table.
+
+#ifndef _KERN_FS_FDTABLE_H_
+#define _KERN_FS_FDTABLE_H_
+
+#ifdef _KERN_
+
+struct file;
+
+void fdtable_init(void);
+
+// Return the open file for descriptor fd of process pid, or NULL.
+struct file *fd_get(uint32_t pid, int fd);
+
+// Install f at the lowest free descriptor of process pid.
+// Return the descriptor, or -1 if the table cannot grow.
+int fd_alloc(uint32_t pid, struct file *f);
+
+// Remove descriptor fd of process pid and return its file, or NULL.
+struct file *fd_free(uint32_t pid, int fd);
+
+// Give process child a copy of parent's descriptors, as fork does.
+// Return 0, or -1 if out of memory.
+int fd_copy(uint32_t parent, uint32_t child);
+
+// Close all descriptors of process pid and release its table.
+void fd_closeall(uint32_t pid);
+
+#endif  /* _KERN_ */
+
+#endif  /* !_KERN_FS_FDTABLE_H_ */
@@ -3,19 +3,31 @@
 #include <kern/lib/types.h>
 #include <kern/lib/debug.h>
 #include <kern/lib/spinlock.h>
+#include <kern/lib/pmap.h>
+#include <kern/lib/string.h>
+#include <kern/lib/x86.h>
+#include <kern/lib/syscall.h>
+#include <pmm/MATOp/export.h>
+#include <kern/thread/PCurID/export.h>
 #include "params.h"
 #include "stat.h"
 #include "dinode.h"
 #include "inode.h"
+#include "dir.h"
 #include "file.h"
+#include "fcntl.h"
 #include "log.h"
 
 #include <kern/flock/flock.h>
 #include <kern/flock/export.h>
 
+// File structures are carved out of pages allocated on demand
+// and are never freed; unused ones are kept on a free list.
+#define NFILEPERPAGE (PAGESIZE / sizeof(struct file))
+
 struct {
     spinlock_t lock;
-    struct file file[NFILE];
+    struct file *free;  // free list, linked through next
 } ftable;
 
 void file_init(void)
@@ -34,37 +46,29 @@ int file_flock(struct file *f, int operation) {
 
         if (operation & LOCK_SH || operation & LOCK_UN) return -1; 
 
-        if (f->holding_flock) {
-            f->holding_flock = FALSE;
-            if (flock_release(&f->ip->flock) == -1) return -1;
-        } 
-        result = flock_acquire(&f->ip->flock, operation);
-        if (result >= 0) f->holding_flock = TRUE;
+        result = flock_acquire(&f->ip->flock, operation, f->holding_flock);
+        if (result >= 0) f->holding_flock = LOCK_EX;
         return result; 
         
     } else if (operation & LOCK_SH) {
 
         if (operation & LOCK_EX || operation & LOCK_UN) return -1;
 
-        if (f->holding_flock) {
-            f->holding_flock = FALSE;
-            if (flock_release(&f->ip->flock) < 0) return -1;
-        } 
-        result = flock_acquire(&f->ip->flock, operation);
-        if (result >= 0) f->holding_flock = TRUE;
+        result = flock_acquire(&f->ip->flock, operation, f->holding_flock);
+        if (result >= 0) f->holding_flock = LOCK_SH;
         return result; 
 
     } else if (operation & LOCK_UN) {
 
         if (operation & LOCK_EX || operation & LOCK_SH) return -1; 
 
-        if (f->holding_flock == FALSE) return -1;
+        if (f->holding_flock == 0) return -1;
 
         result = flock_release(&f->ip->flock);
 
         if (result < 0) return -1;
 
-        f->holding_flock = FALSE;
+        f->holding_flock = 0;
 
         return result;
 
@@ -74,6 +78,112 @@ int file_flock(struct file *f, int operation) {
     return -1;
 }
 
+/**
+ * Set the queueing policy for flock() on f (LOCKPOL_*), or only look it
+ * up if policy is -1. Return the previous policy, or -1 if policy is
+ * invalid.
+ */
+int file_lockpolicy(struct file *f, int policy)
+{
+    if (f->type != FD_INODE)
+        return -1;
+    return flock_policy(&f->ip->flock, policy);
+}
+
+/**
+ * Run the byte-range lock command cmd (F_GETLK, F_SETLK or F_SETLKW) for
+ * process owner on f. For F_GETLK, *fl is overwritten with a lock that
+ * would block it, or gets l_type F_UNLCK if there is none.
+ * Return 0, EWOULDBLOCK if F_SETLK would have to wait, -E_INVAL if the
+ * request is malformed, -E_BADF if f is not open for the kind of lock
+ * asked for, or -E_MEM if there are no lock records left.
+ */
+int file_rangelock(struct file *f, int owner, int cmd, struct flock *fl)
+{
+    struct rlock conflict;
+    int64_t start;
+    uint64_t end;
+    uint32_t base;
+    int r;
+
+    if (fl->l_type != F_RDLCK && fl->l_type != F_WRLCK
+        && fl->l_type != F_UNLCK)
+        return -E_INVAL;
+    if (f->type != FD_INODE
+        || (fl->l_type == F_RDLCK && !f->readable)
+        || (fl->l_type == F_WRLCK && !f->writable))
+        return -E_BADF;
+
+    switch (fl->l_whence) {
+    case SEEK_SET:
+        base = 0;
+        break;
+    case SEEK_CUR:
+        base = f->off;
+        break;
+    case SEEK_END:
+        inode_lock(f->ip);
+        base = f->ip->size;
+        inode_unlock(f->ip);
+        break;
+    default:
+        return -E_INVAL;
+    }
+    // A negative length (POSIX's range before l_start) is not supported.
+    if ((int32_t) fl->l_len < 0)
+        return -E_INVAL;
+    start = (int64_t) base + fl->l_start;
+    end = fl->l_len == 0 ? RLOCK_EOF : (uint64_t) start + fl->l_len;
+    if (start < 0 || end > RLOCK_EOF || end <= (uint64_t) start)
+        return -E_INVAL;
+
+    if (cmd == F_GETLK) {
+        if (fl->l_type == F_UNLCK)
+            return -E_INVAL;
+        if (rangelock_test(&f->ip->rlock, owner, fl->l_type, start, end,
+                           &conflict)) {
+            fl->l_type = conflict.type;
+            fl->l_whence = SEEK_SET;
+            fl->l_start = conflict.start;
+            fl->l_len = conflict.end == RLOCK_EOF
+                ? 0 : conflict.end - conflict.start;
+            fl->l_pid = conflict.owner;
+        } else {
+            fl->l_type = F_UNLCK;
+        }
+        return 0;
+    }
+    if (cmd != F_SETLK && cmd != F_SETLKW)
+        return -E_INVAL;
+    if (fl->l_type == F_UNLCK)
+        r = rangelock_release(&f->ip->rlock, owner, start, end);
+    else
+        r = rangelock_acquire(&f->ip->rlock, owner, fl->l_type, start, end,
+                              cmd == F_SETLKW);
+    return r;
+}
+
+/**
+ * Refill the free list with a new page of file structures.
+ * Caller holds ftable.lock. Return 0, or -1 if out of memory.
+ */
+static int file_grow(void)
+{
+    unsigned int pi;
+    struct file *f;
+    int i;
+
+    if ((pi = palloc()) == 0)
+        return -1;
+    f = (struct file *) (pi * PAGESIZE);
+    memset(f, 0, PAGESIZE);
+    for (i = 0; i < NFILEPERPAGE; i++) {
+        f[i].next = ftable.free;
+        ftable.free = &f[i];
+    }
+    return 0;
+}
+
 /**
  * Allocate a file structure.
  */
@@ -82,15 +192,16 @@ struct file *file_alloc(void)
     struct file *f;
 
     spinlock_acquire(&ftable.lock);
-    for (f = ftable.file; f < ftable.file + NFILE; f++) {
-        if (f->ref == 0) {
-            f->ref = 1;
-            spinlock_release(&ftable.lock);
-            return f;
-        }
+    if (ftable.free == NULL && file_grow() < 0) {
+        spinlock_release(&ftable.lock);
+        return 0;
     }
+    f = ftable.free;
+    ftable.free = f->next;
+    f->next = NULL;
+    f->ref = 1;
     spinlock_release(&ftable.lock);
-    return 0;
+    return f;
 }
 
 /**
@@ -113,10 +224,18 @@ void file_close(struct file *f)
 {
     struct file ff;
 
+    // As with POSIX, closing any descriptor for a file drops all of the
+    // caller's byte-range locks on it.
+    if (f->type == FD_INODE)
+        rangelock_release_all(&f->ip->rlock, get_curid());
+    // Dropping the flock may sleep, so it must not be done under
+    // ftable.lock.
+    if (f->holding_flock)
+        file_flock(f, LOCK_UN);
+
     spinlock_acquire(&ftable.lock);
     if (f->ref < 1)
         KERN_PANIC("file_close");
-    if (f->holding_flock) file_flock(f, LOCK_UN);
     if (--f->ref > 0) {
         spinlock_release(&ftable.lock);
         return;
@@ -124,6 +243,8 @@ void file_close(struct file *f)
     ff = *f;
     f->ref = 0;
     f->type = FD_NONE;
+    f->next = ftable.free;
+    ftable.free = f;
     spinlock_release(&ftable.lock);
 
     if (ff.type == FD_INODE) {
@@ -148,9 +269,22 @@ int file_stat(struct file *f, struct file_stat *st)
 }
 
 /**
- * Read from file f.
+ * Whether n bytes of f at off bypass the buffer cache: the file was
+ * opened with O_DIRECT, is a regular file and the request is aligned
+ * to sectors. Caller holds the inode lock.
  */
-int file_read(struct file *f, char *addr, int n)
+static bool file_is_direct(struct file *f, uint32_t off, int n)
+{
+    return f->direct && f->ip->type == T_FILE
+        && off % BSIZE == 0 && n % BSIZE == 0;
+}
+
+/**
+ * Read n bytes from file f at *poff into user memory and advance *poff.
+ * poff points either at f->off (read) or at a caller's offset (pread).
+ */
+static int file_read_at(struct file *f, uint32_t pid, uintptr_t uva, int n,
+                        uint32_t *poff)
 {
     int r;
 
@@ -158,8 +292,16 @@ int file_read(struct file *f, char *addr, int n)
         return -1;
     if (f->type == FD_INODE) {
         inode_lock(f->ip);
-        if ((r = inode_read(f->ip, addr, f->off, n)) > 0)
-            f->off += r;
+        if (file_is_direct(f, *poff, n))
+            r = inode_read_direct(f->ip, pid, uva, *poff, n);
+        else
+            r = inode_read_user(f->ip, pid, uva, *poff, n,
+                                f->advice == FADV_SEQUENTIAL
+                                || f->advice == FADV_NOREUSE);
+        if (r > 0)
+            *poff += r;
+        if (r > 0 && f->advice == FADV_SEQUENTIAL)
+            inode_readahead(f->ip, *poff, NREADAHEAD * BSIZE);
         inode_unlock(f->ip);
         return r;
     }
@@ -168,44 +310,304 @@ int file_read(struct file *f, char *addr, int n)
 }
 
 /**
- * Write to file f.
+ * Start a transaction for writing to f. Files opened with O_NOSYNC add
+ * to the pending transaction instead of starting on an empty log.
+ */
+static void file_begin_write(struct file *f)
+{
+    if (f->nosync)
+        begin_trans_relaxed();
+    else
+        begin_trans();
+}
+
+/**
+ * Finish a write transaction on f. O_NOSYNC writes are left in the log
+ * and remembered on the inode, so that file_fsync() knows to commit.
  */
-int file_write(struct file *f, char *addr, int n)
+static void file_end_write(struct file *f)
+{
+    if (f->nosync) {
+        f->ip->logseq = log_seq();
+        end_trans();
+    } else {
+        commit_trans();
+    }
+}
+
+/**
+ * Write n bytes from user memory to file f at *poff and advance *poff.
+ */
+static int file_write_at(struct file *f, uint32_t pid, uintptr_t uva, int n,
+                         uint32_t *poff)
 {
     int r;
 
     if (f->writable == 0)
         return -1;
     if (f->type == FD_INODE) {
-        // Write a few blocks at a time to avoid exceeding
-        // the maximum log transaction size, including
-        // i-node, indirect block, allocation blocks,
-        // and 2 blocks of slop for non-aligned writes.
-        // this really belongs lower down, since inode_write()
-        // might be writing a device like the console.
-        int max = ((LOGSIZE - 1 - 1 - 2) / 2) * 512;
+        // Write as much as the log can hold per transaction.
+        // The chunk is sized under the inode lock from the blocks
+        // the write really touches (data, inode, indirect and
+        // bitmap blocks), so large writes take as few commits as
+        // the log size allows. If pending O_NOSYNC writes leave too
+        // little room, they are committed first.
         int i = 0;
         while (i < n) {
-            int n1 = n - i;
-            if (n1 > max)
-                n1 = max;
+            int n1;
 
-            begin_trans();
+            file_begin_write(f);
             inode_lock(f->ip);
-            if ((r = inode_write(f->ip, addr + i, f->off, n1)) > 0)
-                f->off += r;
+            if ((n1 = inode_write_fit(f->ip, *poff, n - i, log_space())) == 0) {
+                log_commit();
+                n1 = inode_write_fit(f->ip, *poff, n - i, log_space());
+            }
+            if (n1 == 0)
+                KERN_PANIC("file_write: log too small");
+            if (file_is_direct(f, *poff, n1))
+                r = inode_write_direct(f->ip, pid, uva + i, *poff, n1);
+            else
+                r = inode_write_user(f->ip, pid, uva + i, *poff, n1);
+            if (r > 0)
+                *poff += r;
             inode_unlock(f->ip);
-            commit_trans();
+            file_end_write(f);
 
             if (r < 0)
                 break;
-            if (r != n1)
-                KERN_PANIC("short file_write");
             i += r;
+            if (r != n1)
+                break;  // bad user buffer
         }
-        return i == n ? n : -1;
+        return (i > 0 || n == 0) ? i : -1;
     }
     KERN_PANIC("file_write");
     return -1;
 }
 
+/**
+ * Record or act on an access pattern hint for n bytes of f at off.
+ * n == 0 means up to the end of the file.
+ */
+int file_fadvise(struct file *f, uint32_t off, uint32_t n, int advice)
+{
+    if (f->type != FD_INODE)
+        return -1;
+    if (n == 0 || off + n < off)
+        n = 0xffffffff - off;
+
+    switch (advice) {
+    case FADV_NORMAL:
+    case FADV_RANDOM:
+    case FADV_SEQUENTIAL:
+    case FADV_NOREUSE:
+        f->advice = advice;
+        return 0;
+    case FADV_WILLNEED:
+        // The cache is small; don't read more than half of it.
+        n = MIN(n, NBUF / 2 * BSIZE);
+        inode_lock(f->ip);
+        inode_readahead(f->ip, off, n);
+        inode_unlock(f->ip);
+        return 0;
+    case FADV_DONTNEED:
+        inode_lock(f->ip);
+        inode_drop(f->ip, off, n);
+        inode_unlock(f->ip);
+        return 0;
+    }
+    return -1;
+}
+
+/**
+ * Commit the writes made to file f, if any are still pending in the
+ * log. The log commits all pending blocks at once, so this also makes
+ * the file's metadata durable; fdatasync is the same operation.
+ */
+int file_fsync(struct file *f)
+{
+    if (f->type != FD_INODE)
+        return -1;
+    if (f->ip->logseq != log_seq())
+        return 0;  // committed already
+    begin_trans();
+    commit_trans();
+    return 0;
+}
+
+/**
+ * Copy up to n bytes from fin at fin->off to fout at fout->off inside
+ * the kernel and advance both offsets. Return the number of bytes
+ * copied, which is short only at the end of fin, or -1 on error.
+ */
+int file_copy_range(struct file *fin, struct file *fout, int n)
+{
+    struct inode *a, *b;
+    int i, n1, r;
+
+    if (fin->readable == 0 || fout->writable == 0)
+        return -1;
+    if (fin->type != FD_INODE || fout->type != FD_INODE)
+        return -1;
+    if (fin->ip == fout->ip || n < 0)
+        return -1;
+
+    // Take the two inode locks in address order so that two copies
+    // running in opposite directions cannot deadlock.
+    a = fin->ip < fout->ip ? fin->ip : fout->ip;
+    b = fin->ip < fout->ip ? fout->ip : fin->ip;
+
+    i = 0;
+    while (i < n) {
+        file_begin_write(fout);
+        inode_lock(a);
+        inode_lock(b);
+        n1 = 0;
+        if (fin->off < fin->ip->size) {
+            n1 = MIN(n - i, fin->ip->size - fin->off);
+            if ((r = inode_write_fit(fout->ip, fout->off, n1, log_space())) == 0) {
+                log_commit();
+                r = inode_write_fit(fout->ip, fout->off, n1, log_space());
+            }
+            if ((n1 = r) == 0)
+                KERN_PANIC("file_copy_range: log too small");
+        }
+        r = n1 > 0 ? inode_copy(fout->ip, fout->off, fin->ip, fin->off, n1) : 0;
+        if (r > 0) {
+            fin->off += r;
+            fout->off += r;
+        }
+        inode_unlock(b);
+        inode_unlock(a);
+        file_end_write(fout);
+
+        if (r < 0)
+            return i > 0 ? i : -1;
+        if (r == 0)
+            break;
+        i += r;
+    }
+    return i;
+}
+
+/**
+ * Read from file f.
+ * Data is copied from the buffer cache straight into the user's pages.
+ */
+int file_read(struct file *f, uint32_t pid, uintptr_t uva, int n)
+{
+    return file_read_at(f, pid, uva, n, &f->off);
+}
+
+/**
+ * Write to file f.
+ * Data is copied from the user's pages straight into the buffer cache.
+ */
+int file_write(struct file *f, uint32_t pid, uintptr_t uva, int n)
+{
+    return file_write_at(f, pid, uva, n, &f->off);
+}
+
+/**
+ * Read from file f at offset off. f->off is neither used nor changed.
+ */
+int file_pread(struct file *f, uint32_t pid, uintptr_t uva, int n, uint32_t off)
+{
+    return file_read_at(f, pid, uva, n, &off);
+}
+
+/**
+ * Write to file f at offset off. f->off is neither used nor changed.
+ */
+int file_pwrite(struct file *f, uint32_t pid, uintptr_t uva, int n, uint32_t off)
+{
+    return file_write_at(f, pid, uva, n, &off);
+}
+
+/**
+ * Read from file f into the iovcnt buffers described by iov (already copied
+ * into the kernel), filling each buffer in turn. Stops early at end of file.
+ * Return the total number of bytes read, or -1 if nothing could be read.
+ */
+int file_readv(struct file *f, uint32_t pid, struct iovec *iov, int iovcnt)
+{
+    int i, r, tot = 0;
+
+    for (i = 0; i < iovcnt; i++) {
+        r = file_read(f, pid, (uintptr_t) iov[i].iov_base, iov[i].iov_len);
+        if (r < 0)
+            return tot > 0 ? tot : -1;
+        tot += r;
+        if (r < iov[i].iov_len)
+            break;
+    }
+    return tot;
+}
+
+/**
+ * Write the iovcnt buffers described by iov to file f, in order. Stops
+ * early if a buffer is only partly written.
+ * Return the total number of bytes written, or -1 if nothing could be
+ * written.
+ */
+int file_writev(struct file *f, uint32_t pid, struct iovec *iov, int iovcnt)
+{
+    int i, r, tot = 0;
+
+    for (i = 0; i < iovcnt; i++) {
+        r = file_write(f, pid, (uintptr_t) iov[i].iov_base, iov[i].iov_len);
+        if (r < 0)
+            return tot > 0 ? tot : -1;
+        tot += r;
+        if (r < iov[i].iov_len)
+            break;
+    }
+    return tot;
+}
+
+/**
+ * Read directory entries from directory f, starting at f->off, into the
+ * n-byte buffer at uva in process pid. Free slots are skipped.
+ * Entries are gathered straight out of the pinned directory blocks and
+ * copied out a block's worth at a time.
+ * Return the number of bytes filled (a multiple of sizeof(struct dirent)),
+ * 0 at the end of the directory, or -1 on error.
+ */
+int file_getdents(struct file *f, uint32_t pid, uintptr_t uva, uint32_t n)
+{
+    struct dirent ents[BSIZE / sizeof(struct dirent)], *de;
+    struct dir_iter it;
+    uint32_t off, tot, cnt;
+
+    if (f->readable == 0 || f->type != FD_INODE)
+        return -1;
+
+    inode_lock(f->ip);
+    if (f->ip->type != T_DIR) {
+        inode_unlock(f->ip);
+        return -1;
+    }
+
+    tot = 0;
+    cnt = 0;
+    dir_iter_init(&it, f->ip, f->off);
+    while (tot + sizeof(struct dirent) <= n
+           && (de = dir_iter_next(&it, &off)) != NULL) {
+        f->off = off + sizeof(struct dirent);
+        if (de->inum == 0)
+            continue;
+        ents[cnt++] = *de;
+        tot += sizeof(struct dirent);
+        if (cnt == BSIZE / sizeof(struct dirent)) {
+            pt_copyout(ents, pid, uva, sizeof(ents));
+            uva += sizeof(ents);
+            cnt = 0;
+        }
+    }
+    dir_iter_done(&it);
+    inode_unlock(f->ip);
+
+    if (cnt > 0)
+        pt_copyout(ents, pid, uva, cnt * sizeof(struct dirent));
+    return tot;
+}
@@ -15,6 +15,14 @@
 #include "stat.h"
 #include "inode.h"
 
+// One buffer of a readv/writev request.
+struct iovec {
+    void *iov_base;  // user address of the buffer
+    size_t iov_len;  // length of the buffer
+};
+
+#define IOV_MAX 16  // max buffers per readv/writev
+
 struct file {
     enum { FD_NONE, FD_PIPE, FD_INODE } type;
     int ref;  // reference count
@@ -22,7 +30,11 @@ struct file {
     int8_t writable;
     struct inode *ip;
     uint32_t off;
-    bool holding_flock;
+    int holding_flock;  // LOCK_SH, LOCK_EX or 0
+    bool nosync;  // writes may stay in the log until fsync
+    bool direct;  // aligned I/O bypasses the buffer cache
+    int advice;   // FADV_* access pattern hint
+    struct file *next;  // free list
 };
 
 void file_init(void);
@@ -30,6 +42,13 @@ void file_init(void);
 // Lock the file.
 int file_flock(struct file *f, int operation);
 
+// Set or look up the queueing policy of flock() on the file.
+int file_lockpolicy(struct file *f, int policy);
+
+// Set, clear or test a byte-range lock on the file.
+struct flock;
+int file_rangelock(struct file *f, int owner, int cmd, struct flock *fl);
+
 // Allocate a file structure.
 struct file *file_alloc(void);
 
@@ -42,11 +61,31 @@ void file_close(struct file *f);
 // Get metadata about file f.
 int file_stat(struct file *f, struct file_stat *st);
 
-// Read from file f.
-int file_read(struct file *f, char *addr, int n);
+// Read from file f into user memory at uva in process pid.
+int file_read(struct file *f, uint32_t pid, uintptr_t uva, int n);
+
+// Write to file f from user memory at uva in process pid.
+int file_write(struct file *f, uint32_t pid, uintptr_t uva, int n);
+
+// Read from / write to file f at offset off without touching f->off.
+int file_pread(struct file *f, uint32_t pid, uintptr_t uva, int n, uint32_t off);
+int file_pwrite(struct file *f, uint32_t pid, uintptr_t uva, int n, uint32_t off);
+
+// Scatter/gather read and write over user buffers described by iov.
+int file_readv(struct file *f, uint32_t pid, struct iovec *iov, int iovcnt);
+int file_writev(struct file *f, uint32_t pid, struct iovec *iov, int iovcnt);
+
+// Give a FADV_* access pattern hint for n bytes of file f at off.
+int file_fadvise(struct file *f, uint32_t off, uint32_t n, int advice);
+
+// Force the writes made to file f to disk.
+int file_fsync(struct file *f);
+
+// Copy n bytes from fin to fout at their offsets without leaving the kernel.
+int file_copy_range(struct file *fin, struct file *fout, int n);
 
-// Write to file f.
-int file_write(struct file *f, char *addr, int n);
+// Read directory entries from directory f into user memory.
+int file_getdents(struct file *f, uint32_t pid, uintptr_t uva, uint32_t n);
 
 #define CONSOLE 1
 
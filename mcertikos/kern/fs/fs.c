@@ -0,0 +1,95 @@
+// Bringing up the file system.
+
+#include <kern/lib/types.h>
+#include <kern/lib/debug.h>
+#include <kern/lib/spinlock.h>
+#include <kern/lib/x86.h>
+#include <dev/timer.h>
+#include <thread/PThread/export.h>
+#include "bufcache.h"
+#include "inode.h"
+#include "file.h"
+#include "fdtable.h"
+#include "pagecache.h"
+#include "mmap.h"
+#include "ioring.h"
+#include "log.h"
+#include "fs.h"
+
+enum { FS_UNMOUNTED = 0, FS_MOUNTING, FS_MOUNTED };
+
+// Relaxed transactions (see log.c) are committed at least this often.
+#define FLUSH_TICKS (5 * FREQ)
+
+static spinlock_t fs_lock;
+static volatile int fs_state;
+
+static spinlock_t flush_lock;
+static unsigned int flush_ticks;
+
+static void fs_flusher(void)
+{
+    spinlock_acquire(&flush_lock);
+    while (1) {
+        thread_sleep(&flush_ticks, &flush_lock);
+        spinlock_release(&flush_lock);
+        if (fs_mounted())
+            log_flush();
+        spinlock_acquire(&flush_lock);
+    }
+}
+
+void fs_init(void)
+{
+    spinlock_init(&fs_lock);
+    fs_state = FS_UNMOUNTED;
+
+    bufcache_init();
+    inode_init();
+    file_init();
+    fdtable_init();
+    pagecache_init();
+    mmap_init();
+    ioring_init();
+
+    spinlock_init(&flush_lock);
+    flush_ticks = 0;
+    if (thread_spawn(fs_flusher, 0, 0) == NUM_IDS)
+        KERN_PANIC("fs_init: cannot create the log flusher");
+}
+
+void fs_mount(void)
+{
+    if (fs_state == FS_MOUNTED)
+        return;
+
+    spinlock_acquire(&fs_lock);
+    while (fs_state == FS_MOUNTING)
+        thread_sleep(&fs_lock, &fs_lock);
+    if (fs_state == FS_MOUNTED) {
+        spinlock_release(&fs_lock);
+        return;
+    }
+    fs_state = FS_MOUNTING;
+    spinlock_release(&fs_lock);
+
+    log_init();
+
+    spinlock_acquire(&fs_lock);
+    fs_state = FS_MOUNTED;
+    thread_wakeup(&fs_lock);
+    spinlock_release(&fs_lock);
+}
+
+bool fs_mounted(void)
+{
+    return fs_state == FS_MOUNTED;
+}
+
+bool fs_tick(void)
+{
+    if (++flush_ticks % FLUSH_TICKS != 0)
+        return FALSE;
+    thread_wakeup(&flush_ticks);
+    return TRUE;
+}
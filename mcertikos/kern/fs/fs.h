@@ -0,0 +1,29 @@
+// Bringing up the file system.
+
+#ifndef _KERN_FS_FS_H_
+#define _KERN_FS_FS_H_
+
+#ifdef _KERN_
+
+// Set up the in-memory state of the file system: the caches, the open
+// file table, the descriptor tables, the mappings and the I/O rings.
+// Touches no disk, so it runs at boot before any thread can sleep.
+// Also starts the kernel thread that commits the log periodically.
+void fs_init(void);
+
+// Read the superblock and recover the log of the root device, the first
+// time it is called. Every file-system system call goes through here,
+// as the disk reads must sleep and so need a running process.
+void fs_mount(void);
+
+// Return TRUE once fs_mount() has finished.
+bool fs_mounted(void);
+
+// Called on every timer tick. Every FLUSH_TICKS it wakes the flusher
+// thread and returns TRUE, so the caller can yield to it; the pending
+// relaxed transactions are then committed with log_flush().
+bool fs_tick(void);
+
+#endif  /* _KERN_ */
+
+#endif  /* !_KERN_FS_FS_H_ */
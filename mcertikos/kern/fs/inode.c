@@ -6,11 +6,13 @@
 #include <kern/lib/debug.h>
 #include <kern/lib/string.h>
 #include <kern/lib/spinlock.h>
+#include <kern/lib/pmap.h>
 #include <thread/PThread/export.h>
 #include "bufcache.h"
 #include "log.h"
 #include "block.h"
 #include "inode.h"
+#include "pagecache.h"
 #include <kern/flock/export.h>
 
 struct devsw *devsw;
@@ -25,6 +27,7 @@ struct {
 void inode_init(void)
 {
     spinlock_init(&inode_cache.lock);
+    rangelock_setup();
 }
 
 struct inode *inode_get(uint32_t dev, uint32_t inum);
@@ -107,6 +110,7 @@ struct inode *inode_get(uint32_t dev, uint32_t inum)
 
     ip = empty;
     flock_init(&ip->flock);
+    rangelock_init(&ip->rlock);
     ip->dev = dev;
     ip->inum = inum;
     ip->ref = 1;
@@ -256,6 +260,88 @@ static uint32_t bmap(struct inode *ip, uint32_t bn)
     return 0;
 }
 
+/**
+ * Return a B_BUSY buf holding the bn-th data block of ip.
+ */
+struct buf *inode_block_read(struct inode *ip, uint32_t bn)
+{
+    return bufcache_read(ip->dev, bmap(ip, bn));
+}
+
+/**
+ * Return a B_BUSY buf for the block of ip holding off, which is about
+ * to receive m bytes at off. A write covering the whole block does not
+ * need the old contents, so the block is not read from disk; the caller
+ * sets B_VALID once it has filled the block.
+ */
+static struct buf *inode_write_block(struct inode *ip, uint32_t off, uint32_t m)
+{
+    uint32_t addr = bmap(ip, off / BSIZE);
+
+    if (m == BSIZE)
+        return bufcache_getblk(ip->dev, addr);
+    return bufcache_read(ip->dev, addr);
+}
+
+/**
+ * Return how many of the n bytes at off can be written to ip by a
+ * transaction that can still log space blocks (see log_space()).
+ * Counts the blocks the write really touches: the data blocks, the
+ * inode block, the indirect block if the range reaches it, and one
+ * bitmap block per allocation (at most one per bitmap block on disk).
+ * Blocks already logged by the transaction are counted again, so the
+ * estimate errs on the safe side.
+ */
+uint32_t inode_write_fit(struct inode *ip, uint32_t off, uint32_t n, int space)
+{
+    uint32_t tot, m, bn;
+    uint32_t *ind;
+    struct buf *bp;
+    struct superblock sb;
+    int ndata, nalloc, nbitmap, indirect;
+
+    if (ip->type == T_DEV)
+        return n;
+    if (off + n < off || off + n > MAXFILE * BSIZE)
+        return n;  // inode_write() rejects it as a whole
+
+    read_superblock(ip->dev, &sb);
+    nbitmap = sb.size / BPB + 1;
+
+    bp = NULL;
+    ind = NULL;
+    ndata = nalloc = indirect = 0;
+    for (tot = 0; tot < n; tot += m, off += m) {
+        m = min(n - tot, BSIZE - off % BSIZE);
+        bn = off / BSIZE;
+
+        ndata++;
+        if (bn < NDIRECT) {
+            if (ip->addrs[bn] == 0)
+                nalloc++;
+        } else {
+            if (!indirect) {
+                indirect = 1;
+                if (ip->addrs[NDIRECT] == 0) {
+                    nalloc++;
+                } else {
+                    bp = bufcache_read(ip->dev, ip->addrs[NDIRECT]);
+                    ind = (uint32_t *) bp->data;
+                }
+            }
+            if (ind == NULL || ind[bn - NDIRECT] == 0)
+                nalloc++;
+        }
+
+        if (1 + ndata + indirect + MIN(nalloc, nbitmap) > space)
+            break;
+    }
+
+    if (bp != NULL)
+        bufcache_release(bp);
+    return tot;
+}
+
 /**
  * Truncate inode (discard contents).
  * Only called when the inode has no links
@@ -269,6 +355,8 @@ static void inode_trunc(struct inode *ip)
     struct buf *bp;
     uint32_t *a;
 
+    pagecache_invalidate(ip);
+
     for (i = 0; i < NDIRECT; i++) {
         if (ip->addrs[i]) {
             block_free(ip->dev, ip->addrs[i]);
@@ -352,10 +440,12 @@ int inode_write(struct inode *ip, char *src, uint32_t off, uint32_t n)
         return -1;
 
     for (tot = 0; tot < n; tot += m, off += m, src += m) {
-        bp = bufcache_read(ip->dev, bmap(ip, off / BSIZE));
         m = min(n - tot, BSIZE - off % BSIZE);
+        bp = inode_write_block(ip, off, m);
         memmove(bp->data + off % BSIZE, src, m);
+        bp->flags |= B_VALID;
         log_write(bp);
+        pagecache_update(ip, off, bp->data + off % BSIZE, m);
         bufcache_release(bp);
     }
 
@@ -365,3 +455,227 @@ int inode_write(struct inode *ip, char *src, uint32_t off, uint32_t n)
     }
     return n;
 }
+
+/**
+ * Read data from inode into user memory.
+ * Each block is copied directly from the buffer cache to the user pages.
+ */
+int inode_read_user(struct inode *ip, uint32_t pid, uintptr_t dst,
+                    uint32_t off, uint32_t n, bool once)
+{
+    uint32_t tot, m;
+    struct buf *bp;
+    char kbuf[BSIZE];
+    int r = 0;
+
+    if (ip->type == T_DEV) {
+        // Devices only speak kernel buffers; bounce a block at a time.
+        for (tot = 0; tot < n; tot += r, dst += r) {
+            if ((r = inode_read(ip, kbuf, off, min(n - tot, BSIZE))) <= 0)
+                break;
+            if (pt_copyout(kbuf, pid, dst, r) != r)
+                return -1;
+        }
+        return tot > 0 ? tot : r;
+    }
+
+    if (off > ip->size || off + n < off)
+        return -1;
+    if (off + n > ip->size)
+        n = ip->size - off;
+
+    for (tot = 0; tot < n; tot += m, off += m, dst += m) {
+        bp = bufcache_read(ip->dev, bmap(ip, off / BSIZE));
+        m = min(n - tot, BSIZE - off % BSIZE);
+        if (pt_copyout(bp->data + off % BSIZE, pid, dst, m) != m) {
+            bufcache_release(bp);
+            return -1;
+        }
+        // Blocks read once are recycled first, once fully consumed.
+        if (once && (off + m) % BSIZE == 0)
+            bufcache_release_cold(bp);
+        else
+            bufcache_release(bp);
+    }
+    return n;
+}
+
+void inode_readahead(struct inode *ip, uint32_t off, uint32_t n)
+{
+    uint32_t bn, end;
+
+    if (ip->type == T_DEV || off >= ip->size)
+        return;
+    end = (n > ip->size - off) ? ip->size : off + n;
+    for (bn = off / BSIZE; bn * BSIZE < end; bn++)
+        bufcache_prefetch(ip->dev, bmap(ip, bn));
+}
+
+void inode_drop(struct inode *ip, uint32_t off, uint32_t n)
+{
+    uint32_t bn, end;
+
+    if (ip->type == T_DEV || off >= ip->size)
+        return;
+    end = (n > ip->size - off) ? ip->size : off + n;
+    for (bn = off / BSIZE; bn * BSIZE < end; bn++)
+        bufcache_drop(ip->dev, bmap(ip, bn));
+}
+
+/**
+ * Write data to inode from user memory.
+ * Each piece is copied from the user pages into a bounce buffer first,
+ * so a bad user address never leaves half-written data in the cache.
+ * Return the number of bytes written, or -1 if none were.
+ */
+int inode_write_user(struct inode *ip, uint32_t pid, uintptr_t src,
+                     uint32_t off, uint32_t n)
+{
+    uint32_t tot, m;
+    struct buf *bp;
+    char kbuf[BSIZE];
+    int r = 0;
+
+    if (ip->type == T_DEV) {
+        for (tot = 0; tot < n; tot += r, src += r) {
+            m = min(n - tot, BSIZE);
+            if (pt_copyin(pid, src, kbuf, m) != m)
+                return -1;
+            if ((r = inode_write(ip, kbuf, off, m)) <= 0)
+                break;
+        }
+        return tot > 0 ? tot : r;
+    }
+
+    if (off > ip->size || off + n < off)
+        return -1;
+    if (off + n > MAXFILE * BSIZE)
+        return -1;
+
+    for (tot = 0; tot < n; tot += m, off += m, src += m) {
+        m = min(n - tot, BSIZE - off % BSIZE);
+        if (pt_copyin(pid, src, kbuf, m) != m)
+            break;
+        bp = inode_write_block(ip, off, m);
+        memmove(bp->data + off % BSIZE, kbuf, m);
+        bp->flags |= B_VALID;
+        log_write(bp);
+        pagecache_update(ip, off, bp->data + off % BSIZE, m);
+        bufcache_release(bp);
+    }
+
+    if (tot > 0 && off > ip->size) {
+        ip->size = off;
+        inode_update(ip);
+    }
+    return (tot > 0 || n == 0) ? tot : -1;
+}
+
+int inode_copy(struct inode *dst, uint32_t doff, struct inode *src,
+               uint32_t soff, uint32_t n)
+{
+    uint32_t tot, m;
+    struct buf *bin, *bout;
+
+    if (src->type == T_DEV || dst->type == T_DEV)
+        return -1;
+    if (soff > src->size)
+        return -1;
+    if (soff + n < soff || soff + n > src->size)
+        n = src->size - soff;
+    if (doff > dst->size || doff + n < doff)
+        return -1;
+    if (doff + n > MAXFILE * BSIZE)
+        return -1;
+
+    // Each step moves the largest piece that stays inside one source
+    // block and one destination block, straight between the two bufs.
+    for (tot = 0; tot < n; tot += m, soff += m, doff += m) {
+        m = min(n - tot, BSIZE - soff % BSIZE);
+        m = min(m, BSIZE - doff % BSIZE);
+        bin = inode_block_read(src, soff / BSIZE);
+        bout = inode_write_block(dst, doff, m);
+        memmove(bout->data + doff % BSIZE, bin->data + soff % BSIZE, m);
+        bufcache_release(bin);
+        bout->flags |= B_VALID;
+        log_write(bout);
+        pagecache_update(dst, doff, bout->data + doff % BSIZE, m);
+        bufcache_release(bout);
+    }
+
+    if (n > 0 && doff > dst->size) {
+        dst->size = doff;
+        inode_update(dst);
+    }
+    return n;
+}
+
+int inode_read_direct(struct inode *ip, uint32_t pid, uintptr_t dst,
+                      uint32_t off, uint32_t n)
+{
+    uint32_t tot, m, addr;
+    struct buf *bp, db;
+    uint8_t *data;
+    int r;
+
+    if (ip->type == T_DEV || off % BSIZE != 0)
+        return -1;
+    if (off > ip->size || off + n < off)
+        return -1;
+    if (off + n > ip->size)
+        n = ip->size - off;
+
+    for (tot = 0; tot < n; tot += m, off += m, dst += m) {
+        m = min(n - tot, BSIZE);
+        addr = bmap(ip, off / BSIZE);
+        // A cached copy may be newer than the disk (e.g. still in the log).
+        if ((bp = bufcache_lookup(ip->dev, addr)) != NULL) {
+            data = bp->data;
+        } else {
+            if (bufcache_direct(&db, ip->dev, addr, FALSE) < 0)
+                return -1;
+            data = db.data;
+        }
+        r = pt_copyout(data, pid, dst, m);
+        if (bp != NULL)
+            bufcache_release(bp);
+        if (r != m)
+            return -1;
+    }
+    return n;
+}
+
+int inode_write_direct(struct inode *ip, uint32_t pid, uintptr_t src,
+                       uint32_t off, uint32_t n)
+{
+    uint32_t tot, addr;
+    struct buf *bp, db;
+
+    if (ip->type == T_DEV || off % BSIZE != 0 || n % BSIZE != 0)
+        return -1;
+    if (off > ip->size || off + n < off)
+        return -1;
+    if (off + n > MAXFILE * BSIZE)
+        return -1;
+
+    for (tot = 0; tot < n; tot += BSIZE, off += BSIZE, src += BSIZE) {
+        addr = bmap(ip, off / BSIZE);  // allocation is logged as usual
+        if (pt_copyin(pid, src, db.data, BSIZE) != BSIZE)
+            break;
+        if (bufcache_direct(&db, ip->dev, addr, TRUE) < 0)
+            break;
+        // Keep a cached copy in step, or a later commit of the log
+        // could put the old contents back.
+        if ((bp = bufcache_lookup(ip->dev, addr)) != NULL) {
+            memmove(bp->data, db.data, BSIZE);
+            bufcache_release(bp);
+        }
+        pagecache_update(ip, off, db.data, BSIZE);
+    }
+
+    if (tot > 0 && off > ip->size) {
+        ip->size = off;
+        inode_update(ip);
+    }
+    return (tot > 0 || n == 0) ? tot : -1;
+}
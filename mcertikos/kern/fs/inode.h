@@ -84,6 +84,8 @@ struct inode {
     uint32_t size;
     uint32_t addrs[NDIRECT + 1];
     struct flock_t flock;
+    struct rangelock_t rlock;  // fcntl byte-range locks
+    uint32_t logseq;  // log transaction of the last relaxed write
 };
 
 // Table mapping major device number to device functions
@@ -147,6 +149,68 @@ int inode_read(struct inode *ip, char *dst, uint32_t off, uint32_t n);
 /** Write data to inode. */
 int inode_write(struct inode *ip, char *src, uint32_t off, uint32_t n);
 
+/**
+ * Read data from inode straight into user memory at dst in process pid,
+ * one block at a time, without an intermediate kernel buffer.
+ * If once is set the data is not expected to be read again, and the
+ * blocks consumed are recycled before other cached blocks.
+ */
+int inode_read_user(struct inode *ip, uint32_t pid, uintptr_t dst,
+                    uint32_t off, uint32_t n, bool once);
+
+/**
+ * Bring the blocks holding n bytes at off into the buffer cache.
+ */
+void inode_readahead(struct inode *ip, uint32_t off, uint32_t n);
+
+/**
+ * Drop the clean cached blocks holding n bytes at off.
+ */
+void inode_drop(struct inode *ip, uint32_t off, uint32_t n);
+
+/**
+ * Write data to inode from user memory at src in process pid, one block
+ * at a time. Stop at the first bad user address; return the bytes
+ * written, or -1 if none were.
+ */
+int inode_write_user(struct inode *ip, uint32_t pid, uintptr_t src,
+                     uint32_t off, uint32_t n);
+
+/**
+ * O_DIRECT variants of inode_read_user() and inode_write_user(): data
+ * moves between user memory and the disk one sector at a time without
+ * going through the buffer cache or the log. off must be sector-aligned,
+ * and so must n for writes. Cached copies of the sectors are used for
+ * reads and updated by writes, so the cache stays consistent.
+ */
+int inode_read_direct(struct inode *ip, uint32_t pid, uintptr_t dst,
+                      uint32_t off, uint32_t n);
+int inode_write_direct(struct inode *ip, uint32_t pid, uintptr_t src,
+                       uint32_t off, uint32_t n);
+
+/**
+ * Copy n bytes of src at soff to dst at doff, block by block through
+ * the buffer cache. Stops at the end of src. The caller holds both
+ * inode locks and a transaction.
+ */
+int inode_copy(struct inode *dst, uint32_t doff, struct inode *src,
+               uint32_t soff, uint32_t n);
+
+/**
+ * Return how many of the n bytes at off can be written to ip by a
+ * transaction that can still log space blocks.
+ */
+uint32_t inode_write_fit(struct inode *ip, uint32_t off, uint32_t n, int space);
+
+struct buf;
+
+/**
+ * Return a B_BUSY buf holding the bn-th data block of ip,
+ * allocating the block if necessary. The caller must hold
+ * the inode lock and release the buf with bufcache_release().
+ */
+struct buf *inode_block_read(struct inode *ip, uint32_t bn);
+
 #endif  /* _KERN_ */
 
 #endif  /* !_KERN_FS_INODE_H_ */
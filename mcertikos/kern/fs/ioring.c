@@ -0,0 +1,99 @@
+// Asynchronous I/O rings. See ioring.h.
+
+#include <kern/lib/types.h>
+#include <kern/lib/debug.h>
+#include <kern/lib/string.h>
+#include <kern/lib/spinlock.h>
+#include <kern/lib/x86.h>
+#include <pmm/MATOp/export.h>
+#include <vmm/MPTKern/export.h>
+#include "ioring.h"
+
+struct {
+    spinlock_t lock;
+    struct io_ring *ring[NUM_IDS];
+} ioring_table;
+
+void ioring_init(void)
+{
+    if (sizeof(struct io_ring) > PAGESIZE)
+        KERN_PANIC("ioring_init: ring does not fit in a page");
+    spinlock_init(&ioring_table.lock);
+}
+
+uintptr_t ioring_setup(uint32_t pid)
+{
+    unsigned int pi;
+    struct io_ring *r;
+
+    if (pid >= NUM_IDS || ioring_table.ring[pid] != NULL)
+        return 0;
+    if ((pi = palloc()) == 0)
+        return 0;
+    r = (struct io_ring *) (pi * PAGESIZE);
+    memset(r, 0, PAGESIZE);
+    if (map_page(pid, VM_IORING, pi, PTE_P | PTE_W | PTE_U) == MagicNumber) {
+        pfree(pi);
+        return 0;
+    }
+
+    spinlock_acquire(&ioring_table.lock);
+    ioring_table.ring[pid] = r;
+    spinlock_release(&ioring_table.lock);
+    return VM_IORING;
+}
+
+struct io_ring *ioring_get(uint32_t pid)
+{
+    struct io_ring *r;
+
+    if (pid >= NUM_IDS)
+        return NULL;
+    spinlock_acquire(&ioring_table.lock);
+    r = ioring_table.ring[pid];
+    spinlock_release(&ioring_table.lock);
+    return r;
+}
+
+int ioring_next(struct io_ring *r, struct io_sqe *sqe)
+{
+    uint32_t head = r->sq_head;
+
+    if (head == r->sq_tail)
+        return -1;  // nothing submitted
+    if (r->cq_tail - r->cq_head >= NIOCQ)
+        return -1;  // completion queue full
+    // Read the entry only after the tail that published it.
+    asm volatile ("" ::: "memory");
+    *sqe = r->sq[head % NIOSQ];
+    r->sq_head = head + 1;
+    return 0;
+}
+
+void ioring_complete(struct io_ring *r, uint32_t user_data, int res)
+{
+    struct io_cqe *cqe = &r->cq[r->cq_tail % NIOCQ];
+
+    cqe->user_data = user_data;
+    cqe->res = res;
+    // Publish the entry before the tail that makes it visible.
+    asm volatile ("" ::: "memory");
+    r->cq_tail++;
+}
+
+void ioring_free(uint32_t pid)
+{
+    struct io_ring *r;
+
+    if (pid >= NUM_IDS)
+        return;
+    spinlock_acquire(&ioring_table.lock);
+    r = ioring_table.ring[pid];
+    ioring_table.ring[pid] = NULL;
+    spinlock_release(&ioring_table.lock);
+
+    if (r != NULL) {
+        unmap_page(pid, VM_IORING);
+        pfree((uintptr_t) r / PAGESIZE);
+    }
+}
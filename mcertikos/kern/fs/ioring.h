@@ -0,0 +1,95 @@
+// Asynchronous I/O rings.
+//
+// A process that calls sys_io_setup() gets one page shared with the
+// kernel, mapped at VM_IORING, holding a submission queue and a
+// completion queue. The process fills in submission entries and
+// advances sq_tail without trapping; a single sys_io_enter() then runs
+// every queued request and posts one completion entry per request,
+// advancing cq_tail. The process consumes completions by advancing
+// cq_head.
+//
+// The heads and tails are free-running counters; an entry's slot is its
+// counter modulo the queue size. The kernel only trusts what it copies
+// out of the page, so a misbehaving process can only confuse itself.
+//
+// The ring is not inherited across fork; a child calls sys_io_setup()
+// for its own. Nothing else may be mapped in the 4 MB page table that
+// holds VM_IORING, since map_cow() skips it.
+//
+// The layout is shared with user space; see user/include/ioring.h.
+
+#ifndef _KERN_FS_IORING_H_
+#define _KERN_FS_IORING_H_
+
+#ifdef _KERN_
+
+#include <lib/vm.h>
+
+#define NIOSQ 64  // submission queue entries
+#define NIOCQ 64  // completion queue entries
+
+// Request opcodes
+#define IO_OP_NOP   0
+#define IO_OP_READ  1  // read len bytes from fd into addr
+#define IO_OP_WRITE 2  // write len bytes from addr to fd
+#define IO_OP_FSYNC 3  // fsync fd
+#define IO_OP_OPEN  4  // open path addr (len bytes with the NUL), mode off
+#define IO_OP_CLOSE 5  // close fd
+
+#define IO_OFF_CUR 0xffffffff  // read/write at the file offset, and advance it
+
+struct io_sqe {
+    uint32_t op;         // IO_OP_*
+    int32_t fd;
+    uint32_t addr;       // user buffer or path
+    uint32_t len;
+    uint32_t off;        // file offset, IO_OFF_CUR, or open mode
+    uint32_t user_data;  // copied to the completion
+};
+
+struct io_cqe {
+    uint32_t user_data;
+    int32_t res;         // result, or the negated error number
+};
+
+struct io_ring {
+    volatile uint32_t sq_head;  // written by the kernel
+    volatile uint32_t sq_tail;  // written by the process
+    volatile uint32_t cq_head;  // written by the process
+    volatile uint32_t cq_tail;  // written by the kernel
+    struct io_sqe sq[NIOSQ];
+    struct io_cqe cq[NIOCQ];
+};
+
+void ioring_init(void);
+
+/**
+ * Allocate process pid's ring and map it at VM_IORING.
+ * Return VM_IORING, or 0 on error or if pid already has a ring.
+ */
+uintptr_t ioring_setup(uint32_t pid);
+
+/**
+ * Return process pid's ring, or NULL if it has none.
+ */
+struct io_ring *ioring_get(uint32_t pid);
+
+/**
+ * Copy the next submission of r into *sqe and consume it.
+ * Return 0, or -1 if there is none or no room for its completion.
+ */
+int ioring_next(struct io_ring *r, struct io_sqe *sqe);
+
+/**
+ * Post a completion to r. ioring_next() has made sure there is room.
+ */
+void ioring_complete(struct io_ring *r, uint32_t user_data, int res);
+
+/**
+ * Unmap and free process pid's ring, as on exit.
+ */
+void ioring_free(uint32_t pid);
+
+#endif  /* _KERN_ */
+
+#endif  /* !_KERN_FS_IORING_H_ */
@@ -15,6 +15,13 @@
 // this means that they may observe uncommitted data. I-node and
 // buffer locks prevent read-only calls from seeing inconsistent data.
 //
+// A relaxed operation (begin_trans_relaxed() ... end_trans()) does not
+// commit when it ends: its blocks stay in the in-memory transaction and
+// the next operation adds to it. Everything pending is committed
+// together by the next commit_trans(), by log_flush(), or by end_trans()
+// once LOGLAZY blocks are pending. begin_trans() commits pending blocks
+// first so that ordinary operations still start with an empty log.
+//
 // The log is a physical re-do log containing disk blocks.
 // The on-disk log format:
 //   header block, containing sector #s for block A, B, C, ...
@@ -22,7 +29,9 @@
 //   block B
 //   block C
 //   ...
-// Log appends are synchronous.
+// Logged blocks stay pinned in the buffer cache and are copied into
+// the log only at commit, so a block written many times by one
+// transaction is written to the log once.
 
 #include <kern/lib/types.h>
 #include <kern/lib/debug.h>
@@ -43,8 +52,9 @@ struct log {
     spinlock_t lock;
     int start;
     int size;
-    int busy;  // a transaction is active
+    int busy;      // a transaction is active
     int dev;
+    uint32_t seq;  // number of the open (uncommitted) transaction
     struct logheader lh;
 };
 struct log log;
@@ -62,6 +72,7 @@ void log_init(void)
     log.start = sb.size - sb.nlog;
     log.size = sb.nlog;
     log.dev = ROOTDEV;
+    log.seq = 1;
     recover_from_log();
 }
 
@@ -80,6 +91,22 @@ static void install_trans(void)
     }
 }
 
+// Copy the blocks of the current transaction from the cache to the log.
+static void write_log(void)
+{
+    int tail;
+
+    for (tail = 0; tail < log.lh.n; tail++) {
+        struct buf *to = bufcache_getblk(log.dev, log.start + tail + 1);  // log block
+        struct buf *from = bufcache_read(log.dev, log.lh.sector[tail]);   // cached block
+        memmove(to->data, from->data, BSIZE);
+        to->flags |= B_VALID;
+        bufcache_write(to);
+        bufcache_release(from);
+        bufcache_release(to);
+    }
+}
+
 // Read the log header from disk into the in-memory log header.
 static void read_head(void)
 {
@@ -116,7 +143,7 @@ static void recover_from_log(void)
     write_head();     // clear the log
 }
 
-void begin_trans(void)
+void begin_trans_relaxed(void)
 {
     spinlock_acquire(&log.lock);
     while (log.busy) {
@@ -126,24 +153,71 @@ void begin_trans(void)
     spinlock_release(&log.lock);
 }
 
-void commit_trans(void)
+void log_commit(void)
 {
+    if (!log.busy)
+        KERN_PANIC("log_commit outside of trans");
+
     if (log.lh.n > 0) {
+        write_log();      // Write modified blocks from cache to log
         write_head();     // Write header to disk -- the real commit
         install_trans();  // Now install writes to home locations
         log.lh.n = 0;
         write_head();     // Erase the transaction from the log
+        log.seq++;
     }
+}
 
+void begin_trans(void)
+{
+    begin_trans_relaxed();
+    log_commit();  // start with an empty log
+}
+
+static void end_op(void)
+{
     spinlock_acquire(&log.lock);
     log.busy = 0;
     thread_wakeup(&log);
     spinlock_release(&log.lock);
 }
 
+void commit_trans(void)
+{
+    log_commit();
+    end_op();
+}
+
+void end_trans(void)
+{
+    if (log.lh.n >= LOGLAZY)
+        log_commit();
+    end_op();
+}
+
+void log_flush(void)
+{
+    if (log.lh.n == 0)
+        return;
+    begin_trans();  // commits whatever is pending
+    end_op();
+}
+
+uint32_t log_seq(void)
+{
+    return log.seq;
+}
+
+// Return how many more distinct blocks the current transaction
+// can log; log_write() panics beyond this.
+int log_space(void)
+{
+    return MIN(LOGSIZE, log.size - 1) - log.lh.n;
+}
+
 // Caller has modified b->data and is done with the buffer.
-// Append the block to the log and record the block number,
-// but don't write the log header (which would commit the write).
+// Record the block number and pin the block in the cache;
+// it is copied to the log when the transaction commits.
 // log_write() replaces bwrite(); a typical use is:
 //   bp = bufcache_read(...)
 //   modify bp->data[]
@@ -153,9 +227,6 @@ void log_write(struct buf *b)
 {
     int i;
 
-    if (log.lh.n >= LOGSIZE || log.lh.n >= log.size - 1)
-        KERN_PANIC("too big a transaction. %d < %d <= %d",
-                   log.size, log.lh.n, LOGSIZE);
     if (!log.busy)
         KERN_PANIC("write outside of trans");
 
@@ -163,11 +234,11 @@ void log_write(struct buf *b)
         if (log.lh.sector[i] == b->sector)  // log absorbtion?
             break;
     }
+    // Only a block that is not absorbed needs a new log slot.
+    if (i == log.lh.n && (log.lh.n >= LOGSIZE || log.lh.n >= log.size - 1))
+        KERN_PANIC("too big a transaction. %d < %d <= %d",
+                   log.size, log.lh.n, LOGSIZE);
     log.lh.sector[i] = b->sector;
-    struct buf *lbuf = bufcache_read(b->dev, log.start + i + 1);
-    memmove(lbuf->data, b->data, BSIZE);
-    bufcache_write(lbuf);
-    bufcache_release(lbuf);
     if (i == log.lh.n)
         log.lh.n++;
     b->flags |= B_DIRTY;  // XXX: prevent eviction
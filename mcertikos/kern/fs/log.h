@@ -15,6 +15,10 @@
 // this means that they may observe uncommitted data. I-node and
 // buffer locks prevent read-only calls from seeing inconsistent data.
 //
+// An operation started with begin_trans_relaxed() and finished with
+// end_trans() is not committed when it ends; it stays in memory until
+// a later commit_trans(), log_flush() or a nearly full log commits it.
+//
 // The log is a physical re-do log containing disk blocks.
 // The on-disk log format:
 //   header block, containing sector #s for block A, B, C, ...
@@ -22,7 +26,7 @@
 //   block B
 //   block C
 //   ...
-// Log appends are synchronous.
+// Logged blocks are copied into the log at commit.
 
 #ifndef _KERN_FS_LOG_H_
 #define _KERN_FS_LOG_H_
@@ -33,13 +37,39 @@
 
 void log_init(void);
 
+// Start an operation. Blocks left pending by relaxed operations are
+// committed first, so the operation has the whole log to itself.
 void begin_trans(void);
 
+// Start an operation that adds to whatever is pending in the log.
+// The caller must size its writes with log_space().
+void begin_trans_relaxed(void);
+
+// Finish an operation and commit everything pending.
 void commit_trans(void);
 
+// Finish an operation without forcing it to disk. Pending blocks are
+// committed only once LOGLAZY of them have accumulated.
+void end_trans(void);
+
+// Commit everything pending from inside an operation.
+void log_commit(void);
+
+// Commit pending relaxed operations. The flusher thread of fs.c calls
+// this every few seconds to bound how much a crash can lose.
+void log_flush(void);
+
+// Return the number of the transaction that is currently open.
+// It changes every time the log commits.
+uint32_t log_seq(void);
+
+// Return how many more distinct blocks the current transaction
+// can log before it is full.
+int log_space(void);
+
 // Caller has modified b->data and is done with the buffer.
-// Append the block to the log and record the block number,
-// but don't write the log header (which would commit the write).
+// Record the block in the current transaction and pin it in the
+// cache, but don't write the log header (which would commit the write).
 // log_write() replaces bwrite(); a typical use is:
 //   bp = bufcache_read(...)
 //   modify bp->data[]
@@ -18,13 +18,13 @@ typedef unsigned int		uint32_t;
 typedef unsigned char  uchar;
 typedef unsigned int  uint;
 
-#include "../lib/buf.h"
 #include "params.h"
 #include "stat.h"
 #include "dinode.h"
 #include "path.h"
 #include "dir.h"
 
+#undef static_assert
 #define static_assert(a, b) do { switch (0) case 0: case (a): ; } while (0)
 
 int nblocks = 985;
@@ -0,0 +1,157 @@
+// File mappings backed by the page cache. See mmap.h.
+
+#include <kern/lib/types.h>
+#include <kern/lib/debug.h>
+#include <kern/lib/spinlock.h>
+#include <kern/lib/x86.h>
+#include <vmm/MPTKern/export.h>
+#include <vmm/MPTOp/export.h>
+#include "inode.h"
+#include "file.h"
+#include "log.h"
+#include "pagecache.h"
+#include "mmap.h"
+
+struct mmap_region {
+    uintptr_t va;       // start of the mapping, 0 if the slot is free
+    uint32_t len;       // length, rounded up to whole pages
+    uint32_t off;       // file offset mapped at va
+    struct inode *ip;   // mapped file, with a reference held
+};
+
+struct {
+    spinlock_t lock;
+    struct mmap_region region[NUM_IDS][NMMAP];
+} mmap_table;
+
+void mmap_init(void)
+{
+    spinlock_init(&mmap_table.lock);
+}
+
+/**
+ * Find a free range of len bytes for process pid. Caller holds the lock.
+ */
+static uintptr_t mmap_find_va(uint32_t pid, uint32_t len)
+{
+    struct mmap_region *r;
+    uintptr_t va = VM_MMAPLO;
+    int i;
+
+again:
+    if (va + len < va || va + len > VM_MMAPHI)
+        return 0;
+    for (i = 0; i < NMMAP; i++) {
+        r = &mmap_table.region[pid][i];
+        if (r->va != 0 && va < r->va + r->len && r->va < va + len) {
+            va = r->va + r->len;
+            goto again;
+        }
+    }
+    return va;
+}
+
+uintptr_t mmap_file(uint32_t pid, struct file *f, uint32_t len, uint32_t off)
+{
+    struct mmap_region *r;
+    uintptr_t va;
+    int i;
+
+    if (f->type != FD_INODE || f->readable == 0)
+        return 0;
+    if (len == 0 || off % PAGESIZE != 0)
+        return 0;
+    len = ROUNDUP(len, PAGESIZE);
+
+    spinlock_acquire(&mmap_table.lock);
+    for (i = 0; i < NMMAP; i++) {
+        if (mmap_table.region[pid][i].va == 0)
+            break;
+    }
+    if (i == NMMAP || (va = mmap_find_va(pid, len)) == 0) {
+        spinlock_release(&mmap_table.lock);
+        return 0;
+    }
+    r = &mmap_table.region[pid][i];
+    r->va = va;
+    r->len = len;
+    r->off = off;
+    r->ip = inode_dup(f->ip);
+    spinlock_release(&mmap_table.lock);
+
+    return va;
+}
+
+int mmap_unmap(uint32_t pid, uintptr_t va)
+{
+    struct mmap_region *r, reg;
+    struct page *pg;
+    uintptr_t pva;
+    int i;
+
+    spinlock_acquire(&mmap_table.lock);
+    for (i = 0; i < NMMAP; i++) {
+        r = &mmap_table.region[pid][i];
+        if (r->va != 0 && r->va == va)
+            break;
+    }
+    if (i == NMMAP) {
+        spinlock_release(&mmap_table.lock);
+        return -1;
+    }
+    reg = *r;
+    r->va = 0;
+    spinlock_release(&mmap_table.lock);
+
+    // Unmap the pages that were faulted in and drop their references.
+    for (pva = reg.va; pva < reg.va + reg.len; pva += PAGESIZE) {
+        if ((get_ptbl_entry_by_va(pid, pva) & PTE_P) == 0)
+            continue;
+        unmap_page(pid, pva);
+        pg = pagecache_lookup(reg.ip->dev, reg.ip->inum,
+                              (reg.off + (pva - reg.va)) / PAGESIZE);
+        if (pg == NULL)
+            KERN_PANIC("mmap_unmap: mapped page not cached");
+        pagecache_put(pg);  // the lookup's reference
+        pagecache_put(pg);  // the mapping's reference
+    }
+
+    begin_trans();
+    inode_put(reg.ip);
+    commit_trans();
+    return 0;
+}
+
+int mmap_fault(uint32_t pid, uintptr_t va)
+{
+    struct mmap_region *r;
+    struct inode *ip;
+    struct page *pg;
+    uint32_t pgno;
+    int i;
+
+    va = ROUNDDOWN(va, PAGESIZE);
+
+    spinlock_acquire(&mmap_table.lock);
+    for (i = 0; i < NMMAP; i++) {
+        r = &mmap_table.region[pid][i];
+        if (r->va != 0 && r->va <= va && va < r->va + r->len)
+            break;
+    }
+    if (i == NMMAP) {
+        spinlock_release(&mmap_table.lock);
+        return -1;
+    }
+    ip = r->ip;
+    pgno = (r->off + (va - r->va)) / PAGESIZE;
+    spinlock_release(&mmap_table.lock);
+
+    // The page keeps the reference we get here until it is unmapped.
+    if ((pg = pagecache_get(ip, pgno)) == NULL)
+        return -1;
+    if (map_page(pid, va, pg->pi, PTE_P | PTE_U) == MagicNumber) {
+        pagecache_put(pg);
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,45 @@
+// File mappings.
+//
+// A process can map a file read-only into its address space. Mappings
+// are placed in [VM_MMAPLO, VM_MMAPHI) and are populated lazily: the
+// page fault handler calls mmap_fault(), which maps the page cache page
+// (see pagecache.h) holding that part of the file. Every process mapping
+// the same part of a file shares the same physical page, and reading it
+// takes neither a system call nor a copy.
+//
+// Mappings are not inherited across fork: map_cow() skips the window.
+
+#ifndef _KERN_FS_MMAP_H_
+#define _KERN_FS_MMAP_H_
+
+#ifdef _KERN_
+
+#include <lib/vm.h>
+
+struct file;
+
+void mmap_init(void);
+
+/**
+ * Map len bytes of file f, starting at the page-aligned offset off, into
+ * process pid. Return the virtual address of the mapping, or 0 on error.
+ */
+uintptr_t mmap_file(uint32_t pid, struct file *f, uint32_t len, uint32_t off);
+
+/**
+ * Remove the mapping of process pid starting at va.
+ * Return 0 on success, -1 if there is no such mapping.
+ */
+int mmap_unmap(uint32_t pid, uintptr_t va);
+
+/**
+ * Resolve a page fault of process pid at va against its file mappings.
+ * The page fault handler calls this for every fault in the mmap window.
+ * Return 0 if the fault was resolved, -1 if va is not in a file mapping
+ * (or the page could not be brought in).
+ */
+int mmap_fault(uint32_t pid, uintptr_t va);
+
+#endif  /* _KERN_ */
+
+#endif  /* !_KERN_FS_MMAP_H_ */
@@ -0,0 +1,218 @@
+// Page cache.
+//
+// Whole 4 KB pages of file data, filled from the buffer cache and kept
+// coherent with it by inode_write(), so that they can be mapped directly
+// into processes by mmap. See pagecache.h.
+
+#include <kern/lib/types.h>
+#include <kern/lib/debug.h>
+#include <kern/lib/string.h>
+#include <kern/lib/spinlock.h>
+#include <kern/lib/x86.h>
+#include <thread/PThread/export.h>
+#include <pmm/MATOp/export.h>
+#include "inode.h"
+#include "pagecache.h"
+
+#define NPHASH 31
+
+#define PAGE_KVA(pg) ((char *) ((pg)->pi * PAGESIZE))
+
+struct {
+    spinlock_t lock;
+    struct page page[NPAGE];
+    struct page *hash[NPHASH];
+
+    // Linked list of all pages, through prev/next.
+    // head.next is most recently used.
+    struct page head;
+} pcache;
+
+static uint32_t pagecache_hash(uint32_t dev, uint32_t inum, uint32_t pgno)
+{
+    return (dev * 7 + inum * 31 + pgno) % NPHASH;
+}
+
+void pagecache_init(void)
+{
+    struct page *pg;
+
+    spinlock_init(&pcache.lock);
+
+    pcache.head.prev = &pcache.head;
+    pcache.head.next = &pcache.head;
+    for (pg = pcache.page; pg < pcache.page + NPAGE; pg++) {
+        pg->next = pcache.head.next;
+        pg->prev = &pcache.head;
+        pg->dev = -1;
+        pcache.head.next->prev = pg;
+        pcache.head.next = pg;
+    }
+}
+
+/**
+ * Find the cached page. Caller holds pcache.lock.
+ */
+static struct page *pagecache_find(uint32_t dev, uint32_t inum, uint32_t pgno)
+{
+    struct page *pg;
+
+    for (pg = pcache.hash[pagecache_hash(dev, inum, pgno)]; pg != NULL;
+         pg = pg->hnext) {
+        if (pg->dev == dev && pg->inum == inum && pg->pgno == pgno)
+            return pg;
+    }
+    return NULL;
+}
+
+/**
+ * Remove pg from its hash chain, if it is on one. Caller holds pcache.lock.
+ */
+static void pagecache_unhash(struct page *pg)
+{
+    struct page **pp;
+
+    if (pg->dev == -1)
+        return;
+    for (pp = &pcache.hash[pagecache_hash(pg->dev, pg->inum, pg->pgno)];
+         *pp != NULL; pp = &(*pp)->hnext) {
+        if (*pp == pg) {
+            *pp = pg->hnext;
+            break;
+        }
+    }
+    pg->hnext = NULL;
+    pg->dev = -1;
+    pg->flags = 0;
+}
+
+/**
+ * Move pg to the head of the MRU list. Caller holds pcache.lock.
+ */
+static void pagecache_touch(struct page *pg)
+{
+    pg->next->prev = pg->prev;
+    pg->prev->next = pg->next;
+    pg->next = pcache.head.next;
+    pg->prev = &pcache.head;
+    pcache.head.next->prev = pg;
+    pcache.head.next = pg;
+}
+
+struct page *pagecache_lookup(uint32_t dev, uint32_t inum, uint32_t pgno)
+{
+    struct page *pg;
+
+    spinlock_acquire(&pcache.lock);
+    if ((pg = pagecache_find(dev, inum, pgno)) != NULL)
+        pg->ref++;
+    spinlock_release(&pcache.lock);
+    return pg;
+}
+
+struct page *pagecache_get(struct inode *ip, uint32_t pgno)
+{
+    struct page *pg;
+    uint32_t h;
+    int n;
+
+    spinlock_acquire(&pcache.lock);
+
+loop:
+    // Is the page already cached?
+    if ((pg = pagecache_find(ip->dev, ip->inum, pgno)) != NULL) {
+        if (pg->flags & P_BUSY) {
+            thread_sleep(pg, &pcache.lock);
+            goto loop;
+        }
+        pg->ref++;
+        pagecache_touch(pg);
+        spinlock_release(&pcache.lock);
+        return pg;
+    }
+
+    // Not cached; recycle the least recently used unreferenced page.
+    for (pg = pcache.head.prev; pg != &pcache.head; pg = pg->prev) {
+        if (pg->ref == 0 && !(pg->flags & P_BUSY))
+            break;
+    }
+    if (pg == &pcache.head) {
+        spinlock_release(&pcache.lock);
+        KERN_WARN("pagecache_get: no pages\n");
+        return NULL;
+    }
+    if (pg->pi == 0 && (pg->pi = palloc()) == 0) {
+        spinlock_release(&pcache.lock);
+        KERN_WARN("pagecache_get: out of memory\n");
+        return NULL;
+    }
+
+    pagecache_unhash(pg);
+    pg->dev = ip->dev;
+    pg->inum = ip->inum;
+    pg->pgno = pgno;
+    pg->ref = 1;
+    pg->flags = P_BUSY;
+    h = pagecache_hash(pg->dev, pg->inum, pgno);
+    pg->hnext = pcache.hash[h];
+    pcache.hash[h] = pg;
+    pagecache_touch(pg);
+    spinlock_release(&pcache.lock);
+
+    // Fill the page through the buffer cache; zero whatever lies past EOF.
+    // It must be valid before the inode lock is dropped, or a write in
+    // between would skip it in pagecache_update() and leave it stale.
+    inode_lock(ip);
+    n = 0;
+    if (pgno * PAGESIZE < ip->size)
+        n = inode_read(ip, PAGE_KVA(pg), pgno * PAGESIZE, PAGESIZE);
+    if (n < 0)
+        n = 0;
+    memset(PAGE_KVA(pg) + n, 0, PAGESIZE - n);
+
+    spinlock_acquire(&pcache.lock);
+    pg->flags = P_VALID;
+    thread_wakeup(pg);
+    spinlock_release(&pcache.lock);
+    inode_unlock(ip);
+
+    return pg;
+}
+
+void pagecache_put(struct page *pg)
+{
+    spinlock_acquire(&pcache.lock);
+    if (pg->ref < 1)
+        KERN_PANIC("pagecache_put");
+    pg->ref--;
+    spinlock_release(&pcache.lock);
+}
+
+void pagecache_update(struct inode *ip, uint32_t off, const void *src, uint32_t n)
+{
+    struct page *pg;
+
+    spinlock_acquire(&pcache.lock);
+    pg = pagecache_find(ip->dev, ip->inum, off / PAGESIZE);
+    // A page still being filled has not read the file yet: it does so
+    // under the inode lock, which the writer holds, and so will see the
+    // new data.
+    if (pg != NULL && (pg->flags & P_VALID))
+        memmove(PAGE_KVA(pg) + off % PAGESIZE, src, n);
+    spinlock_release(&pcache.lock);
+}
+
+void pagecache_invalidate(struct inode *ip)
+{
+    struct page *pg;
+
+    spinlock_acquire(&pcache.lock);
+    for (pg = pcache.page; pg < pcache.page + NPAGE; pg++) {
+        if (pg->dev == ip->dev && pg->inum == ip->inum) {
+            if (pg->ref > 0)
+                KERN_PANIC("pagecache_invalidate: page in use");
+            pagecache_unhash(pg);
+        }
+    }
+    spinlock_release(&pcache.lock);
+}
@@ -0,0 +1,80 @@
+// Page cache.
+//
+// The page cache holds whole 4 KB pages of file data, indexed by
+// (device, inode number, page number within the file). It sits on top
+// of the buffer cache: a page is filled from the file's blocks through
+// inode_read(), and writes to a file are copied through to any cached
+// page that covers them, so a cached page always matches the file.
+//
+// Its pages are ordinary physical pages, so they can be mapped straight
+// into a process (see mmap.h) and shared by every process mapping the
+// same part of the file.
+//
+// Interface:
+// * pagecache_get() returns a referenced page with valid contents,
+//   filling it from the file if necessary.
+// * pagecache_put() drops the reference. Only unreferenced pages are
+//   recycled, least recently used first.
+//
+// The implementation uses two state flags internally:
+// * P_BUSY: the page is being filled; wait for it.
+// * P_VALID: the page holds the file's data.
+
+#ifndef _KERN_FS_PAGECACHE_H_
+#define _KERN_FS_PAGECACHE_H_
+
+#ifdef _KERN_
+
+#include "params.h"
+
+#define P_BUSY  0x1
+#define P_VALID 0x2
+
+struct inode;
+
+struct page {
+    uint32_t dev;         // Device number
+    uint32_t inum;        // Inode number
+    uint32_t pgno;        // Page number within the file
+    int ref;              // Mappings and other in-kernel users
+    int flags;            // P_BUSY, P_VALID
+    uint32_t pi;          // Physical page index, 0 if none yet
+    struct page *hnext;   // Hash chain
+    struct page *prev;    // LRU list
+    struct page *next;
+};
+
+void pagecache_init(void);
+
+/**
+ * Return a referenced page holding page pgno of ip, reading it in if
+ * it is not cached. The caller must not hold the inode lock.
+ * Return NULL if no page can be recycled or allocated.
+ */
+struct page *pagecache_get(struct inode *ip, uint32_t pgno);
+
+/**
+ * Return the cached page pgno of (dev, inum) with an extra reference,
+ * or NULL if it is not cached.
+ */
+struct page *pagecache_lookup(uint32_t dev, uint32_t inum, uint32_t pgno);
+
+/**
+ * Drop a reference to pg.
+ */
+void pagecache_put(struct page *pg);
+
+/**
+ * Copy n bytes just written to ip at off into the cached page covering
+ * them, if any. The range must not cross a block boundary.
+ */
+void pagecache_update(struct inode *ip, uint32_t off, const void *src, uint32_t n);
+
+/**
+ * Drop every cached page of ip. Called when its content is discarded.
+ */
+void pagecache_invalidate(struct inode *ip);
+
+#endif  /* _KERN_ */
+
+#endif  /* !_KERN_FS_PAGECACHE_H_ */
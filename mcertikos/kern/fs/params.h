@@ -3,14 +3,22 @@
 
 #ifdef _KERN_
 
-#define NOFILE  16  // open files per process
-#define NFILE   100 // open files per system
-#define NBUF    10  // size of disk block cache
+#define NFDPAGE 16  // max pages of file descriptors per process
+#define NBUF    (LOGSIZE * 3)  // size of disk block cache; logged blocks stay pinned
+#define NREADAHEAD 2  // blocks read ahead for FADV_SEQUENTIAL files
+#define NPREFETCH 4   // read-ahead reads pending at once; they hold bufs
+#define NPAGE   64  // size of file page cache (4 KB pages)
+#define NMMAP   8   // file mappings per process
 #define NINODE  50  // maximum number of active i-nodes
 #define NDEV    10  // maximum major device number
+#ifdef RAMDISK
+#define ROOTDEV 2   // root on the RAM disk, RAMDISK_DEV in dev/disk/ramdisk.h
+#else
 #define ROOTDEV 1   // device number of file system root disk
+#endif
 #define MAXARG  32  // max exec arguments
 #define LOGSIZE 10  // max data sectors in on-disk log
+#define LOGLAZY 5   // pending sectors that force a relaxed commit
 
 #define ROOTINO 1    // root i-number
 #define BSIZE   512  // block size
@@ -80,11 +80,12 @@ static struct inode *namex(char *path, bool nameiparent, char *name)
     struct inode *ip, *next;
 
     // If path is a full path, get the pointer to the root inode. Otherwise get
-    // the inode corresponding to the current working directory.
-    if (*path == '/') {
+    // the inode corresponding to the current working directory, which is
+    // the root until the process calls chdir.
+    if (*path == '/' || tcb_get_cwd(get_curid()) == NULL) {
         ip = inode_get(ROOTDEV, ROOTINO);
     } else {
-        ip = inode_dup((struct inode *) tcb_get_cwd(get_curid()));
+        ip = inode_dup(tcb_get_cwd(get_curid()));
     }
 
     while ((path = skipelem(path, name)) != 0) {
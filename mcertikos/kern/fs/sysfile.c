@@ -10,16 +10,16 @@
 #include <kern/thread/PTCBIntro/export.h>
 #include <kern/thread/PCurID/export.h>
 #include <kern/trap/TSyscallArg/export.h>
+#include <dev/disk/diskstat.h>
 
 #include "dir.h"
 #include "path.h"
 #include "file.h"
 #include "fcntl.h"
 #include "log.h"
-
-#define BUFLEN_MAX 10000
-char fsbuf[BUFLEN_MAX];
-spinlock_t fsbuf_lk;
+#include "mmap.h"
+#include "fdtable.h"
+#include "ioring.h"
 
 static char *flock_operations[4] = {
     "LOCK_SH",
@@ -28,15 +28,11 @@ static char *flock_operations[4] = {
     "LOCK_NB"
 };
 
-void fs_init(void) {
-    spinlock_init(&fsbuf_lk);
-}
-
-static bool check_buf(tf_t *tf, uintptr_t buf, size_t len, size_t maxlen) {
+static bool check_buf(uintptr_t buf, size_t len, size_t maxlen) {
     if (!(VM_USERLO <= buf && buf + len <= VM_USERHI)
         || (0 < maxlen && maxlen <= len)) {
-        syscall_set_errno(tf, E_INVAL_ADDR);
-        syscall_set_retval1(tf, -1);
+        syscall_set_errno(E_INVAL_ADDR);
+        syscall_set_retval1(-1);
         return FALSE;
     }
     return TRUE;
@@ -45,209 +41,513 @@ static bool check_buf(tf_t *tf, uintptr_t buf, size_t len, size_t maxlen) {
 /**
  * This function is not a system call handler, but an auxiliary function
  * used by sys_open.
- * Allocate a file descriptor for the given file.
- * You should scan the list of open files for the current thread
- * and find the first file descriptor that is available.
- * Return the found descriptor or -1 if none of them is free.
+ * Allocate the lowest free file descriptor of the current process for
+ * the given file, growing its descriptor table if needed.
+ * Return the descriptor or -1 if the table is full.
  */
 static int fdalloc(struct file *f)
 {
-    int fd;
-    int pid = get_curid();
-    struct file **openfiles = tcb_get_openfiles(pid);
-
-    for (fd = 0; fd < NOFILE; fd++) {
-        if (openfiles[fd] == NULL) {
-            tcb_set_openfiles(pid, fd, f);
-            return fd;
-        }
-    }
-
-    return -1;
+    return fd_alloc(get_curid(), f);
 }
 
 /**
  * From the file indexed by the given file descriptor, read n bytes and save them
- * into the buffer in the user. As explained in the assignment specification,
- * you should first write to a kernel buffer then copy the data into user buffer
- * with pt_copyout.
+ * into the buffer in the user. The data is copied from the buffer cache directly
+ * into the user's pages, so there is no bounce buffer, no global lock and no cap
+ * on n; reads from different processes proceed in parallel.
  * Return Value: Upon successful completion, read() shall return a non-negative
  * integer indicating the number of bytes actually read. Otherwise, the
  * functions shall return -1 and set errno E_BADF to indicate the error.
  */
-void sys_read(tf_t *tf)
+void sys_read(void)
 {
     struct file *file;
     int read;
 
     int pid = get_curid();
-    int fd = syscall_get_arg2(tf);
-    uintptr_t buf = syscall_get_arg3(tf);
-    size_t buflen = syscall_get_arg4(tf);
+    int fd = syscall_get_arg2();
+    uintptr_t buf = syscall_get_arg3();
+    size_t buflen = syscall_get_arg4();
 
-    if (!check_buf(tf, buf, buflen, BUFLEN_MAX)) {
+    if (!check_buf(buf, buflen, 0)) {
         return;
     }
-    if (!(0 <= fd && fd < NOFILE)) {
-        syscall_set_errno(tf, E_BADF);
-        syscall_set_retval1(tf, -1);
-        return;
-    }
-
-    file = tcb_get_openfiles(pid)[fd];
+    file = fd_get(pid, fd);
     if (file == NULL || file->type != FD_INODE) {
-        syscall_set_errno(tf, E_BADF);
-        syscall_set_retval1(tf, -1);
+        syscall_set_errno(E_BADF);
+        syscall_set_retval1(-1);
         return;
     }
 
-    spinlock_acquire(&fsbuf_lk);
-    read = file_read(file, fsbuf, buflen);
-    syscall_set_retval1(tf, read);
+    read = file_read(file, pid, buf, buflen);
+    syscall_set_retval1(read);
     if (0 <= read) {
-        pt_copyout(fsbuf, pid, buf, buflen);
-        syscall_set_errno(tf, E_SUCC);
+        syscall_set_errno(E_SUCC);
     }
     else {
-        syscall_set_errno(tf, E_BADF);
+        syscall_set_errno(E_BADF);
     }
-    spinlock_release(&fsbuf_lk);
 }
 
 /**
  * Write n bytes of data in the user's buffer into the file indexed by the file descriptor.
- * You should first copy the data info an in-kernel buffer with pt_copyin and then
- * pass this buffer to appropriate file manipulation function.
+ * The data is copied from the user's pages directly into the buffer cache.
  * Upon successful completion, write() shall return the number of bytes actually
  * written to the file associated with f. This number shall never be greater
  * than nbyte. Otherwise, -1 shall be returned and errno E_BADF set to indicate the
  * error.
  */
-void sys_write(tf_t *tf)
+void sys_write(void)
 {
     struct file *file;
     int written;
 
     int pid = get_curid();
-    int fd = syscall_get_arg2(tf);
-    uintptr_t buf = syscall_get_arg3(tf);
-    size_t buflen = syscall_get_arg4(tf);
+    int fd = syscall_get_arg2();
+    uintptr_t buf = syscall_get_arg3();
+    size_t buflen = syscall_get_arg4();
 
-    if (!check_buf(tf, buf, buflen, BUFLEN_MAX)) {
+    if (!check_buf(buf, buflen, 0)) {
         return;
     }
-    if (!(0 <= fd && fd < NOFILE)) {
-        syscall_set_errno(tf, E_BADF);
-        syscall_set_retval1(tf, -1);
+    file = fd_get(pid, fd);
+    if (file == NULL || file->type != FD_INODE) {
+        syscall_set_errno(E_BADF);
+        syscall_set_retval1(-1);
         return;
     }
 
-    file = tcb_get_openfiles(pid)[fd];
+    written = file_write(file, pid, buf, buflen);
+
+    syscall_set_retval1(written);
+    if (0 <= written) {
+        syscall_set_errno(E_SUCC);
+    }
+    else {
+        syscall_set_errno(E_BADF);
+    }
+}
+
+/**
+ * Like sys_read, but read from the given offset (arg5) instead of the file
+ * offset, which is left untouched. Processes sharing a file descriptor can
+ * thus read different parts of the file without coordinating on the offset.
+ */
+void sys_pread(void)
+{
+    struct file *file;
+    int read;
+
+    int pid = get_curid();
+    int fd = syscall_get_arg2();
+    uintptr_t buf = syscall_get_arg3();
+    size_t buflen = syscall_get_arg4();
+    uint32_t off = syscall_get_arg5();
+
+    if (!check_buf(buf, buflen, 0)) {
+        return;
+    }
+    file = fd_get(pid, fd);
     if (file == NULL || file->type != FD_INODE) {
-        syscall_set_errno(tf, E_BADF);
-        syscall_set_retval1(tf, -1);
+        syscall_set_errno(E_BADF);
+        syscall_set_retval1(-1);
         return;
     }
 
-    spinlock_acquire(&fsbuf_lk);
-    pt_copyin(pid, buf, fsbuf, buflen);
-    written = file_write(file, fsbuf, buflen);
-    spinlock_release(&fsbuf_lk);
+    read = file_pread(file, pid, buf, buflen, off);
+    syscall_set_retval1(read);
+    if (0 <= read) {
+        syscall_set_errno(E_SUCC);
+    }
+    else {
+        syscall_set_errno(E_BADF);
+    }
+}
 
-    syscall_set_retval1(tf, written);
+/**
+ * Like sys_write, but write at the given offset (arg5) instead of the file
+ * offset, which is left untouched.
+ */
+void sys_pwrite(void)
+{
+    struct file *file;
+    int written;
+
+    int pid = get_curid();
+    int fd = syscall_get_arg2();
+    uintptr_t buf = syscall_get_arg3();
+    size_t buflen = syscall_get_arg4();
+    uint32_t off = syscall_get_arg5();
+
+    if (!check_buf(buf, buflen, 0)) {
+        return;
+    }
+    file = fd_get(pid, fd);
+    if (file == NULL || file->type != FD_INODE) {
+        syscall_set_errno(E_BADF);
+        syscall_set_retval1(-1);
+        return;
+    }
+
+    written = file_pwrite(file, pid, buf, buflen, off);
+    syscall_set_retval1(written);
     if (0 <= written) {
-        syscall_set_errno(tf, E_SUCC);
+        syscall_set_errno(E_SUCC);
     }
     else {
-        syscall_set_errno(tf, E_BADF);
+        syscall_set_errno(E_BADF);
     }
 }
 
 /**
- * Return Value: Upon successful completion, 0 shall be returned; otherwise, -1
- * shall be returned and errno E_BADF set to indicate the error.
+ * Copy the user's iovec array (arg3, arg4 entries) into iov and check that
+ * every buffer it describes lies in user space.
+ * Return the number of entries, or -1 with errno set.
  */
-void sys_close(tf_t *tf)
+static int fetch_iovec(struct iovec *iov)
 {
+    int i;
+    uintptr_t uiov = syscall_get_arg3();
+    int iovcnt = syscall_get_arg4();
+
+    if (!(0 <= iovcnt && iovcnt <= IOV_MAX)) {
+        syscall_set_errno(E_INVAL_ADDR);
+        syscall_set_retval1(-1);
+        return -1;
+    }
+    if (!check_buf(uiov, iovcnt * sizeof(struct iovec), 0)) {
+        return -1;
+    }
+
+    pt_copyin(get_curid(), uiov, iov, iovcnt * sizeof(struct iovec));
+    for (i = 0; i < iovcnt; i++) {
+        if (!check_buf((uintptr_t) iov[i].iov_base, iov[i].iov_len, 0)) {
+            return -1;
+        }
+    }
+    return iovcnt;
+}
+
+/**
+ * Read from the file indexed by the file descriptor into several user
+ * buffers (an iovec array) in a single call.
+ * Return Value: the total number of bytes read. Otherwise, -1 shall be
+ * returned and errno set to indicate the error.
+ */
+void sys_readv(void)
+{
+    struct iovec iov[IOV_MAX];
     struct file *file;
+    int iovcnt, read;
 
     int pid = get_curid();
-    int fd = syscall_get_arg2(tf);
+    int fd = syscall_get_arg2();
 
-    if (!(0 <= fd && fd < NOFILE)) {
-        syscall_set_errno(tf, E_BADF);
-        syscall_set_retval1(tf, -1);
+    if ((iovcnt = fetch_iovec(iov)) < 0) {
         return;
     }
+    file = fd_get(pid, fd);
+    if (file == NULL || file->type != FD_INODE) {
+        syscall_set_errno(E_BADF);
+        syscall_set_retval1(-1);
+        return;
+    }
+
+    read = file_readv(file, pid, iov, iovcnt);
+    syscall_set_retval1(read);
+    if (0 <= read) {
+        syscall_set_errno(E_SUCC);
+    }
+    else {
+        syscall_set_errno(E_BADF);
+    }
+}
+
+/**
+ * Write several user buffers (an iovec array) to the file indexed by the
+ * file descriptor in a single call.
+ * Return Value: the total number of bytes written. Otherwise, -1 shall be
+ * returned and errno set to indicate the error.
+ */
+void sys_writev(void)
+{
+    struct iovec iov[IOV_MAX];
+    struct file *file;
+    int iovcnt, written;
+
+    int pid = get_curid();
+    int fd = syscall_get_arg2();
+
+    if ((iovcnt = fetch_iovec(iov)) < 0) {
+        return;
+    }
+    file = fd_get(pid, fd);
+    if (file == NULL || file->type != FD_INODE) {
+        syscall_set_errno(E_BADF);
+        syscall_set_retval1(-1);
+        return;
+    }
+
+    written = file_writev(file, pid, iov, iovcnt);
+    syscall_set_retval1(written);
+    if (0 <= written) {
+        syscall_set_errno(E_SUCC);
+    }
+    else {
+        syscall_set_errno(E_BADF);
+    }
+}
+
+/**
+ * Fill the user's buffer with as many directory entries (struct dirent) of
+ * the directory indexed by the file descriptor as fit, continuing from the
+ * file offset. A whole directory can thus be listed in a few calls instead of
+ * one sys_read per entry.
+ * Return Value: the number of bytes filled, 0 at the end of the directory.
+ * Otherwise, -1 shall be returned and errno E_BADF set to indicate the error.
+ */
+void sys_getdents(void)
+{
+    struct file *file;
+    int filled;
+
+    int pid = get_curid();
+    int fd = syscall_get_arg2();
+    uintptr_t buf = syscall_get_arg3();
+    size_t buflen = syscall_get_arg4();
+
+    if (!check_buf(buf, buflen, 0)) {
+        return;
+    }
+    file = fd_get(pid, fd);
+    if (file == NULL || file->type != FD_INODE) {
+        syscall_set_errno(E_BADF);
+        syscall_set_retval1(-1);
+        return;
+    }
+
+    filled = file_getdents(file, pid, buf, buflen);
+    syscall_set_retval1(filled);
+    if (0 <= filled) {
+        syscall_set_errno(E_SUCC);
+    }
+    else {
+        syscall_set_errno(E_BADF);
+    }
+}
+
+/**
+ * Copy len bytes from fd_in to fd_out at their current offsets without
+ * passing the data through user space.
+ * Return Value: the number of bytes copied (0 at the end of fd_in), or -1
+ * with errno E_BADF.
+ */
+void sys_copy_file_range(void)
+{
+    struct file *fin, *fout;
+    int copied;
+
+    int pid = get_curid();
+    int fd_in = syscall_get_arg2();
+    int fd_out = syscall_get_arg3();
+    int len = syscall_get_arg4();
+
+    fin = fd_get(pid, fd_in);
+    fout = fd_get(pid, fd_out);
+    if (fin == NULL || fin->type != FD_INODE
+        || fout == NULL || fout->type != FD_INODE) {
+        syscall_set_errno(E_BADF);
+        syscall_set_retval1(-1);
+        return;
+    }
+
+    copied = file_copy_range(fin, fout, len);
+    syscall_set_retval1(copied);
+    if (0 <= copied) {
+        syscall_set_errno(E_SUCC);
+    }
+    else {
+        syscall_set_errno(E_BADF);
+    }
+}
+
+/**
+ * Map a file read-only into the caller's address space.
+ * Arguments: fd, length, page-aligned file offset.
+ * Return Value: the address of the mapping, or 0 with errno set.
+ */
+void sys_mmap(void)
+{
+    struct file *file;
+    uintptr_t va;
+
+    int pid = get_curid();
+    int fd = syscall_get_arg2();
+    uint32_t len = syscall_get_arg3();
+    uint32_t off = syscall_get_arg4();
+
+    file = fd_get(pid, fd);
+    if (file == NULL || file->type != FD_INODE || file->ip->type != T_FILE) {
+        syscall_set_errno(E_BADF);
+        syscall_set_retval1(0);
+        return;
+    }
+
+    va = mmap_file(pid, file, len, off);
+    syscall_set_retval1(va);
+    syscall_set_errno(va != 0 ? E_SUCC : E_INVAL_ADDR);
+}
+
+/**
+ * Remove the mapping that starts at the given address.
+ * Return Value: 0 on success, -1 with errno E_INVAL_ADDR otherwise.
+ */
+void sys_munmap(void)
+{
+    int pid = get_curid();
+    uintptr_t va = syscall_get_arg2();
+
+    if (mmap_unmap(pid, va) < 0) {
+        syscall_set_errno(E_INVAL_ADDR);
+        syscall_set_retval1(-1);
+        return;
+    }
+    syscall_set_errno(E_SUCC);
+    syscall_set_retval1(0);
+}
+
+/**
+ * Return Value: Upon successful completion, 0 shall be returned; otherwise, -1
+ * shall be returned and errno E_BADF set to indicate the error.
+ */
+void sys_close(void)
+{
+    struct file *file;
+
+    int pid = get_curid();
+    int fd = syscall_get_arg2();
 
-    file = tcb_get_openfiles(pid)[fd];
+    file = fd_free(pid, fd);
     if (file == NULL || file->ref < 1) {
-        syscall_set_errno(tf, E_BADF);
-        syscall_set_retval1(tf, -1);
+        syscall_set_errno(E_BADF);
+        syscall_set_retval1(-1);
         return;
     }
 
     file_close(file);
-    tcb_set_openfiles(pid, fd, NULL);
 
-    syscall_set_errno(tf, E_SUCC);
-    syscall_set_retval1(tf, 0);
+    syscall_set_errno(E_SUCC);
+    syscall_set_retval1(0);
 }
 
 /**
- * Return Value: Upon successful completion, 0 shall be returned. Otherwise, -1
+ * Give the kernel a hint about how a range of a file will be accessed.
+ * Arguments: fd, offset, length (0 means to the end), FADV_* advice.
+ * Return Value: Upon successful completion, 0 shall be returned; otherwise, -1
  * shall be returned and errno E_BADF set to indicate the error.
  */
-void sys_fstat(tf_t *tf)
+void sys_fadvise(void)
 {
     struct file *file;
-    struct file_stat fs_stat;
 
     int pid = get_curid();
-    int fd = syscall_get_arg2(tf);
-    uintptr_t stat = syscall_get_arg3(tf);
-
-    if (!check_buf(tf, stat, sizeof(struct file_stat), 0)) {
+    int fd = syscall_get_arg2();
+    uint32_t off = syscall_get_arg3();
+    uint32_t len = syscall_get_arg4();
+    int advice = syscall_get_arg5();
+
+    file = fd_get(pid, fd);
+    if (file == NULL || file_fadvise(file, off, len, advice) < 0) {
+        syscall_set_errno(E_BADF);
+        syscall_set_retval1(-1);
         return;
     }
-    if (!(0 <= fd && fd < NOFILE)) {
-        syscall_set_errno(tf, E_BADF);
-        syscall_set_retval1(tf, -1);
+
+    syscall_set_errno(E_SUCC);
+    syscall_set_retval1(0);
+}
+
+/**
+ * Make the writes to a file durable. Writes through a descriptor opened
+ * with O_NOSYNC may otherwise still be pending in the log.
+ * Return Value: Upon successful completion, 0 shall be returned; otherwise, -1
+ * shall be returned and errno E_BADF set to indicate the error.
+ */
+void sys_fsync(void)
+{
+    struct file *file;
+
+    int pid = get_curid();
+    int fd = syscall_get_arg2();
+
+    file = fd_get(pid, fd);
+    if (file == NULL || file_fsync(file) < 0) {
+        syscall_set_errno(E_BADF);
+        syscall_set_retval1(-1);
         return;
     }
 
-    file = tcb_get_openfiles(pid)[fd];
+    syscall_set_errno(E_SUCC);
+    syscall_set_retval1(0);
+}
+
+/**
+ * Same as sys_fsync: the log cannot commit a file's data without the
+ * metadata that goes with it.
+ */
+void sys_fdatasync(void)
+{
+    sys_fsync();
+}
+
+/**
+ * Return Value: Upon successful completion, 0 shall be returned. Otherwise, -1
+ * shall be returned and errno E_BADF set to indicate the error.
+ */
+void sys_fstat(void)
+{
+    struct file *file;
+    struct file_stat fs_stat;
+
+    int pid = get_curid();
+    int fd = syscall_get_arg2();
+    uintptr_t stat = syscall_get_arg3();
+
+    if (!check_buf(stat, sizeof(struct file_stat), 0)) {
+        return;
+    }
+    file = fd_get(pid, fd);
     if (file == NULL || file->type != FD_INODE) {
-        syscall_set_errno(tf, E_BADF);
-        syscall_set_retval1(tf, -1);
+        syscall_set_errno(E_BADF);
+        syscall_set_retval1(-1);
         return;
     }
 
     if (file_stat(file, &fs_stat) == 0) {
         pt_copyout(&fs_stat, pid, stat, sizeof(struct file_stat));
-        syscall_set_errno(tf, E_SUCC);
-        syscall_set_retval1(tf, 0);
+        syscall_set_errno(E_SUCC);
+        syscall_set_retval1(0);
     }
     else {
-        syscall_set_errno(tf, E_BADF);
-        syscall_set_retval1(tf, -1);
+        syscall_set_errno(E_BADF);
+        syscall_set_retval1(-1);
     }
 }
 
 /**
  * Create the path new as a link to the same inode as old.
  */
-void sys_link(tf_t * tf)
+void sys_link(void)
 {
     char name[DIRSIZ], new[128], old[128];
     struct inode *dp, *ip;
 
-    uintptr_t uold = syscall_get_arg2(tf);
-    uintptr_t unew = syscall_get_arg3(tf);
-    uintptr_t oldlen = syscall_get_arg4(tf);
-    uintptr_t newlen = syscall_get_arg5(tf);
+    uintptr_t uold = syscall_get_arg2();
+    uintptr_t unew = syscall_get_arg3();
+    uintptr_t oldlen = syscall_get_arg4();
+    uintptr_t newlen = syscall_get_arg5();
 
-    if (!check_buf(tf, uold, oldlen, 128) || !check_buf(tf, unew, newlen, 128)) {
+    if (!check_buf(uold, oldlen, 128) || !check_buf(unew, newlen, 128)) {
         return;
     }
 
@@ -255,7 +555,7 @@ void sys_link(tf_t * tf)
     pt_copyin(get_curid(), unew, new, newlen);
 
     if ((ip = namei(old)) == 0) {
-        syscall_set_errno(tf, E_NEXIST);
+        syscall_set_errno(E_NEXIST);
         return;
     }
 
@@ -265,7 +565,7 @@ void sys_link(tf_t * tf)
     if (ip->type == T_DIR) {
         inode_unlockput(ip);
         commit_trans();
-        syscall_set_errno(tf, E_DISK_OP);
+        syscall_set_errno(E_DISK_OP);
         return;
     }
 
@@ -285,7 +585,7 @@ void sys_link(tf_t * tf)
 
     commit_trans();
 
-    syscall_set_errno(tf, E_SUCC);
+    syscall_set_errno(E_SUCC);
     return;
 
 bad:
@@ -294,7 +594,7 @@ bad:
     inode_update(ip);
     inode_unlockput(ip);
     commit_trans();
-    syscall_set_errno(tf, E_DISK_OP);
+    syscall_set_errno(E_DISK_OP);
     return;
 }
 
@@ -303,36 +603,37 @@ bad:
  */
 static int isdirempty(struct inode *dp)
 {
-    int off;
-    struct dirent de;
+    struct dir_iter it;
+    struct dirent *de;
 
-    for (off = 2 * sizeof(de); off < dp->size; off += sizeof(de)) {
-        if (inode_read(dp, (char *) &de, off, sizeof(de)) != sizeof(de))
-            KERN_PANIC("isdirempty: readi");
-        if (de.inum != 0)
+    dir_iter_init(&it, dp, 2 * sizeof(struct dirent));
+    while ((de = dir_iter_next(&it, NULL)) != NULL) {
+        if (de->inum != 0) {
+            dir_iter_done(&it);
             return 0;
+        }
     }
     return 1;
 }
 
-void sys_unlink(tf_t *tf)
+void sys_unlink(void)
 {
     struct inode *ip, *dp;
     struct dirent de;
     char name[DIRSIZ], path[128];
     uint32_t off;
 
-    uintptr_t buf = syscall_get_arg2(tf);
-    size_t buflen = syscall_get_arg3(tf);
+    uintptr_t buf = syscall_get_arg2();
+    size_t buflen = syscall_get_arg3();
 
-    if (!check_buf(tf, buf, buflen, 128)) {
+    if (!check_buf(buf, buflen, 128)) {
         return;
     }
 
     pt_copyin(get_curid(), buf, path, buflen);
 
     if ((dp = nameiparent(path, name)) == 0) {
-        syscall_set_errno(tf, E_DISK_OP);
+        syscall_set_errno(E_DISK_OP);
         return;
     }
 
@@ -370,13 +671,13 @@ void sys_unlink(tf_t *tf)
 
     commit_trans();
 
-    syscall_set_errno(tf, E_SUCC);
+    syscall_set_errno(E_SUCC);
     return;
 
 bad:
     inode_unlockput(dp);
     commit_trans();
-    syscall_set_errno(tf, E_DISK_OP);
+    syscall_set_errno(E_DISK_OP);
     return;
 }
 
@@ -424,88 +725,88 @@ static struct inode *create(char *path, short type, short major, short minor)
     return ip;
 }
 
-void sys_open(tf_t *tf)
+/**
+ * Open (or with O_CREATE, create) the file at path for the current
+ * process. Return the new descriptor, or the negated error number.
+ * Shared by sys_open and the I/O ring.
+ */
+static int open_path(char *path, int omode)
 {
-    char path[128];
-    int fd, omode;
+    int fd;
     struct file *f;
     struct inode *ip;
 
-    uintptr_t buf = syscall_get_arg2(tf);
-    size_t buflen = syscall_get_arg4(tf);
-
-    // KERN_DEBUG("Process: %d, beginning sys_open() on %p\n", get_curid(), buf);
-
-    if (!check_buf(tf, buf, buflen, 128)) {
-        // KERN_DEBUG("Process: %d, ending sys_open()\n", get_curid());
-        return;
-    }
-
-    pt_copyin(get_curid(), buf, path, buflen);
-    omode = syscall_get_arg3(tf);
-
     if (omode & O_CREATE) {
-        // KERN_DEBUG("Process: %d, creating flockfile\n", get_curid());
         begin_trans();
         ip = create(path, T_FILE, 0, 0);
         commit_trans();
-        if (ip == 0) {
-            syscall_set_retval1(tf, -1);
-            syscall_set_errno(tf, E_CREATE);
-            // KERN_DEBUG("Process: %d, ending sys_open()\n", get_curid());
-            return;
-        }
+        if (ip == 0)
+            return -E_CREATE;
     } else {
-        // KERN_DEBUG("Process: %d, START check inode\n");
-        if ((ip = namei(path)) == 0) {
-            syscall_set_retval1(tf, -1);
-            syscall_set_errno(tf, E_NEXIST);
-            // KERN_DEBUG("Process: %d, ending sys_open()\n", get_curid());
-            return;
-        }
+        if ((ip = namei(path)) == 0)
+            return -E_NEXIST;
         inode_lock(ip);
         if (ip->type == T_DIR && omode != O_RDONLY) {
             inode_unlockput(ip);
-            syscall_set_retval1(tf, -1);
-            syscall_set_errno(tf, E_DISK_OP);
-            // KERN_DEBUG("Process: %d, ending sys_open()\n", get_curid());
-            return;
+            return -E_DISK_OP;
         }
-        // KERN_DEBUG("Process: %d, END check inode\n");
     }
 
-    // KERN_DEBUG("Process: %d, START allocating file structure\n");
     if ((f = file_alloc()) == 0 || (fd = fdalloc(f)) < 0) {
         if (f)
             file_close(f);
         inode_unlockput(ip);
-        syscall_set_retval1(tf, -1);
-        syscall_set_errno(tf, E_DISK_OP);
-        // KERN_DEBUG("Process: %d, ending sys_open()\n", get_curid());
-        return;
+        return -E_DISK_OP;
     }
     inode_unlock(ip);
-    // KERN_DEBUG("Process: %d, END allocating file structure\n", get_curid());
 
     f->type = FD_INODE;
     f->ip = ip;
     f->off = 0;
     f->readable = !(omode & O_WRONLY);
     f->writable = (omode & O_WRONLY) || (omode & O_RDWR);
-    syscall_set_retval1(tf, fd);
-    syscall_set_errno(tf, E_SUCC);
-    // KERN_DEBUG("Process: %d, ending sys_open()\n", get_curid());
+    f->nosync = (omode & O_NOSYNC) != 0;
+    f->direct = (omode & O_DIRECT) != 0;
+    f->advice = FADV_NORMAL;
+    return fd;
+}
+
+void sys_open(void)
+{
+    char path[128];
+    int fd, omode;
+
+    uintptr_t buf = syscall_get_arg2();
+    size_t buflen = syscall_get_arg4();
+
+    // KERN_DEBUG("Process: %d, beginning sys_open() on %p\n", get_curid(), buf);
+
+    if (!check_buf(buf, buflen, 128)) {
+        // KERN_DEBUG("Process: %d, ending sys_open()\n", get_curid());
+        return;
+    }
+
+    pt_copyin(get_curid(), buf, path, buflen);
+    omode = syscall_get_arg3();
+
+    if ((fd = open_path(path, omode)) < 0) {
+        syscall_set_retval1(-1);
+        syscall_set_errno(-fd);
+        return;
+    }
+    syscall_set_retval1(fd);
+    syscall_set_errno(E_SUCC);
 }
 
-void sys_mkdir(tf_t *tf)
+void sys_mkdir(void)
 {
     char path[128];
     struct inode *ip;
 
-    uintptr_t buf = syscall_get_arg2(tf);
-    size_t buflen = syscall_get_arg3(tf);
+    uintptr_t buf = syscall_get_arg2();
+    size_t buflen = syscall_get_arg3();
 
-    if (!check_buf(tf, buf, buflen, 128)) {
+    if (!check_buf(buf, buflen, 128)) {
         return;
     }
 
@@ -514,65 +815,254 @@ void sys_mkdir(tf_t *tf)
     begin_trans();
     if ((ip = (struct inode *) create(path, T_DIR, 0, 0)) == 0) {
         commit_trans();
-        syscall_set_errno(tf, E_DISK_OP);
+        syscall_set_errno(E_DISK_OP);
         return;
     }
     inode_unlockput(ip);
     commit_trans();
-    syscall_set_errno(tf, E_SUCC);
+    syscall_set_errno(E_SUCC);
 }
 
-void sys_chdir(tf_t *tf)
+void sys_chdir(void)
 {
     char path[128];
     struct inode *ip;
     int pid = get_curid();
 
-    uintptr_t buf = syscall_get_arg2(tf);
-    size_t buflen = syscall_get_arg3(tf);
+    uintptr_t buf = syscall_get_arg2();
+    size_t buflen = syscall_get_arg3();
 
-    if (!check_buf(tf, buf, buflen, 128)) {
+    if (!check_buf(buf, buflen, 128)) {
         return;
     }
 
     pt_copyin(get_curid(), buf, path, buflen);
 
     if ((ip = namei(path)) == 0) {
-        syscall_set_errno(tf, E_DISK_OP);
+        syscall_set_errno(E_DISK_OP);
         return;
     }
     inode_lock(ip);
     if (ip->type != T_DIR) {
         inode_unlockput(ip);
-        syscall_set_errno(tf, E_DISK_OP);
+        syscall_set_errno(E_DISK_OP);
         return;
     }
     inode_unlock(ip);
-    inode_put(tcb_get_cwd(pid));
+    if (tcb_get_cwd(pid) != NULL)
+        inode_put(tcb_get_cwd(pid));
     tcb_set_cwd(pid, ip);
-    syscall_set_errno(tf, E_SUCC);
+    syscall_set_errno(E_SUCC);
 }
 
-void sys_flock(tf_t *tf) {
-    int fd = syscall_get_arg2(tf), op = syscall_get_arg3(tf);
-    KERN_DEBUG("sys_flock fd %d. operation %s\n", fd, flock_operations[op / 2]);
-    if (fd < 0 || fd >= NOFILE) {
-        syscall_set_retval1(tf, -1);
-        syscall_set_errno(tf, E_BADF);
-        return;
-    }
-    struct file *f = tcb_get_openfiles(get_curid())[fd];
+void sys_flock(void) {
+    int fd = syscall_get_arg2(), op = syscall_get_arg3();
+    KERN_DEBUG("sys_flock fd %d. operation %s\n", fd, flock_operations[(op & (LOCK_SH | LOCK_EX | LOCK_UN)) / 2]);
+    struct file *f = fd_get(get_curid(), fd);
     if (f != NULL && f->type == FD_INODE) {
         if (file_flock(f, op) >= 0) {
-            syscall_set_retval1(tf, 0);
-            syscall_set_errno(tf, E_SUCC);
+            syscall_set_retval1(0);
+            syscall_set_errno(E_SUCC);
         } else {
-            syscall_set_retval1(tf, -1);
-            syscall_set_errno(tf, E_BADF);
+            syscall_set_retval1(-1);
+            syscall_set_errno(E_BADF);
         }
     } else {
-        syscall_set_retval1(tf, -1);
-        syscall_set_errno(tf, E_BADF);
+        syscall_set_retval1(-1);
+        syscall_set_errno(E_BADF);
+        return;
+    }
+}
+
+/**
+ * Byte-range record locks: fcntl(fd, cmd, fl) with cmd F_GETLK, F_SETLK
+ * or F_SETLKW and fl a user struct flock. Locks belong to the calling
+ * process; ranges held by different processes only conflict if one of
+ * them is F_WRLCK.
+ * Return Value: 0 on success (for F_GETLK, fl is updated). Otherwise -1
+ * with errno E_AGAIN if F_SETLK is blocked by another process's lock,
+ * E_INVAL_ADDR for a bad fl, E_INVAL for a bad cmd or lock description,
+ * E_MEM if out of lock records, or E_BADF.
+ *
+ * fcntl(fd, F_GETLKPOL) and fcntl(fd, F_SETLKPOL, policy) look up or set
+ * the queueing policy of flock() on the file (LOCKPOL_*), which lasts
+ * while the file is open.
+ * Return Value: the policy in force before the call, or -1 with errno
+ * E_BADF, or E_INVAL for an unknown policy.
+ */
+void sys_fcntl(void)
+{
+    struct file *f;
+    struct flock fl;
+    int r;
+
+    int pid = get_curid();
+    int fd = syscall_get_arg2();
+    int cmd = syscall_get_arg3();
+    uintptr_t ufl = syscall_get_arg4();
+
+    if (cmd == F_GETLKPOL || cmd == F_SETLKPOL) {
+        if ((f = fd_get(pid, fd)) == NULL || f->type != FD_INODE) {
+            syscall_set_errno(E_BADF);
+            syscall_set_retval1(-1);
+            return;
+        }
+        r = file_lockpolicy(f, cmd == F_SETLKPOL ? ufl : -1);
+        syscall_set_errno(r < 0 ? E_INVAL : E_SUCC);
+        syscall_set_retval1(r);
+        return;
+    }
+
+    if (!check_buf(ufl, sizeof(struct flock), 0)) {
+        return;
+    }
+    if ((f = fd_get(pid, fd)) == NULL || f->type != FD_INODE) {
+        syscall_set_errno(E_BADF);
+        syscall_set_retval1(-1);
+        return;
+    }
+
+    pt_copyin(pid, ufl, &fl, sizeof(struct flock));
+    r = file_rangelock(f, pid, cmd, &fl);
+    if (r == EWOULDBLOCK) {
+        syscall_set_errno(E_AGAIN);
+        syscall_set_retval1(-1);
+        return;
+    }
+    if (r < 0) {
+        syscall_set_errno(-r);
+        syscall_set_retval1(-1);
+        return;
+    }
+    if (cmd == F_GETLK)
+        pt_copyout(&fl, pid, ufl, sizeof(struct flock));
+    syscall_set_errno(E_SUCC);
+    syscall_set_retval1(0);
+}
+
+/**
+ * Give the caller an I/O ring (see ioring.h).
+ * Return Value: the address the ring is mapped at, or 0 with errno E_MEM.
+ */
+void sys_io_setup(void)
+{
+    uintptr_t va = ioring_setup(get_curid());
+
+    syscall_set_retval1(va);
+    syscall_set_errno(va != 0 ? E_SUCC : E_MEM);
+}
+
+/**
+ * check_buf() for I/O ring requests, which have no trap frame to report to.
+ */
+static bool io_check_buf(uintptr_t buf, size_t len)
+{
+    return VM_USERLO <= buf && buf <= buf + len && buf + len <= VM_USERHI;
+}
+
+/**
+ * Run one request taken off the caller's I/O ring.
+ * Return its result, or the negated error number.
+ */
+static int io_submit_one(uint32_t pid, struct io_sqe *sqe)
+{
+    struct file *f;
+    char path[128];
+    int r;
+
+    if (sqe->op == IO_OP_NOP)
+        return 0;
+    if (sqe->op == IO_OP_OPEN) {
+        if (!io_check_buf(sqe->addr, sqe->len)
+            || sqe->len == 0 || sqe->len > sizeof(path))
+            return -E_INVAL_ADDR;
+        if (pt_copyin(pid, sqe->addr, path, sqe->len) != sqe->len)
+            return -E_INVAL_ADDR;
+        path[sqe->len - 1] = '\0';
+        return open_path(path, sqe->off);
+    }
+    if (sqe->op == IO_OP_CLOSE) {
+        if ((f = fd_free(pid, sqe->fd)) == NULL)
+            return -E_BADF;
+        file_close(f);
+        return 0;
+    }
+
+    if ((f = fd_get(pid, sqe->fd)) == NULL || f->type != FD_INODE)
+        return -E_BADF;
+
+    switch (sqe->op) {
+    case IO_OP_READ:
+    case IO_OP_WRITE:
+        if (!io_check_buf(sqe->addr, sqe->len))
+            return -E_INVAL_ADDR;
+        if (sqe->op == IO_OP_READ)
+            r = sqe->off == IO_OFF_CUR
+                ? file_read(f, pid, sqe->addr, sqe->len)
+                : file_pread(f, pid, sqe->addr, sqe->len, sqe->off);
+        else
+            r = sqe->off == IO_OFF_CUR
+                ? file_write(f, pid, sqe->addr, sqe->len)
+                : file_pwrite(f, pid, sqe->addr, sqe->len, sqe->off);
+        return r < 0 ? -E_BADF : r;
+    case IO_OP_FSYNC:
+        return file_fsync(f) < 0 ? -E_BADF : 0;
+    }
+    return -E_INVAL_CALLNR;
+}
+
+/**
+ * Run every request queued on the caller's I/O ring, in order, posting a
+ * completion for each. Stops early if the completion queue fills up.
+ * Return Value: the number of requests run, or -1 with errno E_INVAL_ADDR
+ * if the caller has no ring.
+ */
+void sys_io_enter(void)
+{
+    struct io_ring *r;
+    struct io_sqe sqe;
+    int n = 0;
+
+    int pid = get_curid();
+
+    if ((r = ioring_get(pid)) == NULL) {
+        syscall_set_errno(E_INVAL_ADDR);
+        syscall_set_retval1(-1);
+        return;
+    }
+
+    while (ioring_next(r, &sqe) == 0) {
+        ioring_complete(r, sqe.user_data, io_submit_one(pid, &sqe));
+        n++;
+    }
+    syscall_set_errno(E_SUCC);
+    syscall_set_retval1(n);
+}
+
+/**
+ * Copy the I/O counters of disk device dev (see struct diskstat) into
+ * the user buffer st, so a benchmark can snapshot them before and after
+ * a run.
+ * Return Value: 0 on success, or -1 with errno E_INVAL_ADDR for a bad
+ * buffer or E_INVAL_ID for a device that is not accounted.
+ */
+void sys_diskstat(void)
+{
+    struct diskstat st;
+
+    int pid = get_curid();
+    uint32_t dev = syscall_get_arg2();
+    uintptr_t buf = syscall_get_arg3();
+
+    if (!check_buf(buf, sizeof(struct diskstat), 0)) {
+        return;
+    }
+    if (diskstat_get(dev, &st) < 0) {
+        syscall_set_errno(E_INVAL_ID);
+        syscall_set_retval1(-1);
         return;
     }
-}
\ No newline at end of file
+    pt_copyout(&st, pid, buf, sizeof(struct diskstat));
+    syscall_set_errno(E_SUCC);
+    syscall_set_retval1(0);
+}
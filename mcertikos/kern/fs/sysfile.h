@@ -7,16 +7,31 @@
 
 #ifdef _KERN_
 
-void sys_read(tf_t *tf);
-void sys_write(tf_t *tf);
-void sys_close(tf_t *tf);
-void sys_fstat(tf_t *tf);
-void sys_link(tf_t *tf);
-void sys_unlink(tf_t *tf);
-void sys_open(tf_t *tf);
-void sys_mkdir(tf_t *tf);
-void sys_chdir(tf_t *tf);
-void sys_flock(tf_t *tf);
+void sys_read(void);
+void sys_write(void);
+void sys_pread(void);
+void sys_pwrite(void);
+void sys_readv(void);
+void sys_writev(void);
+void sys_close(void);
+void sys_fadvise(void);
+void sys_fsync(void);
+void sys_fdatasync(void);
+void sys_fstat(void);
+void sys_link(void);
+void sys_unlink(void);
+void sys_open(void);
+void sys_mkdir(void);
+void sys_chdir(void);
+void sys_flock(void);
+void sys_fcntl(void);
+void sys_getdents(void);
+void sys_copy_file_range(void);
+void sys_mmap(void);
+void sys_munmap(void);
+void sys_io_setup(void);
+void sys_io_enter(void);
+void sys_diskstat(void);
 
 #endif  /* _KERN_ */
 
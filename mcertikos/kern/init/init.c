@@ -2,6 +2,8 @@
 #include <lib/types.h>
 #include <lib/monitor.h>
 #include <thread/PThread/export.h>
+#include <dev/disk/disk.h>
+#include <fs/fs.h>
 #include <kern/ipc/pubsub.h> // Include the Pub/Sub IPC header
 
 #ifdef TEST
@@ -68,6 +70,8 @@ static void kern_main(void)
 void kern_init(uintptr_t mbi_addr)
 {
     thread_init(mbi_addr);
+    disk_init();
+    fs_init();
 
     KERN_DEBUG("Kernel initialized.\n");
 
@@ -0,0 +1,32 @@
+#ifndef _KERN_LIB_BUF_H_
+#define _KERN_LIB_BUF_H_
+
+#ifdef _KERN_
+
+#include "types.h"
+
+#define SECTOR_SIZE 512
+
+/**
+ * A disk sector in memory. The buffer cache (kern/fs/bufcache.c) keeps
+ * them on its LRU list through prev/next; the disk driver queues them
+ * through qnext.
+ */
+struct buf {
+    int flags;
+    uint32_t dev;
+    uint32_t sector;
+    struct buf *prev;   // LRU cache list
+    struct buf *next;
+    struct buf *qnext;  // disk queue
+    uint8_t data[SECTOR_SIZE];
+};
+
+#define B_BUSY  0x1  // buffer is locked by some thread
+#define B_VALID 0x2  // buffer has been read from disk
+#define B_DIRTY 0x4  // buffer needs to be written to disk
+#define B_ERROR 0x8  // the last disk transfer of the buffer failed
+
+#endif  /* _KERN_ */
+
+#endif  /* !_KERN_LIB_BUF_H_ */
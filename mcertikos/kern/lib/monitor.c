@@ -9,7 +9,13 @@
 #include <lib/x86.h>
 #include <lib/thread.h>
 #include <lib/monitor.h>
+#include <lib/spinlock.h>
+#include <cv/cv.h>
 #include <dev/console.h>
+#include <dev/disk/disk.h>
+#include <dev/disk/diskstat.h>
+#include <dev/disk/iosched.h>
+#include <dev/disk/ide.h>
 #include <vmm/MPTIntro/export.h>
 #include <vmm/MPTNew/export.h>
 
@@ -17,51 +23,8 @@
 
 #define CMDBUF_SIZE 80 // enough for one VGA text line
 
-typedef struct {
-    int locked;
-    int pid;
-} spinlock_t;
-
-void spinlock_init(spinlock_t *lk) {
-    lk->locked = 0;
-    lk->pid = 0;
-}
-
-void spinlock_acquire(spinlock_t *lk) {
-    lk->locked = 1;
-    lk->pid = 1; // Simulate current process
-}
-
-void spinlock_release(spinlock_t *lk) {
-    lk->locked = 0;
-    lk->pid = 0;
-}
-
-/***** Condition Variable Implementation *****/
-typedef struct {
-    int waiters;
-} cv_t;
-
-void cv_init(cv_t *cv) {
-    cv->waiters = 0;
-}
-
-void cv_wait(cv_t *cv, spinlock_t *lock) {
-    spinlock_release(lock);
-    cv->waiters++;
-    spinlock_acquire(lock);
-}
-
-void cv_signal(cv_t *cv) {
-    if (cv->waiters > 0)
-        cv->waiters--;
-}
-
-void cv_broadcast(cv_t *cv) {
-    cv->waiters = 0;
-}
-
 /***** Flock Implementation *****/
+// A self-contained copy for the monitor tests, kept apart from kern/flock.
 #define LOCK_SH 0b0001
 #define LOCK_EX 0b0010
 #define LOCK_UN 0b0100
@@ -87,7 +50,7 @@ struct flock_t {
     cv_t sh_flock;
 };
 
-void flock_init(struct flock_t *flock) {
+static void flock_init(struct flock_t *flock) {
     flock->num_sh_waiting = 0;
     flock->num_ex_waiting = 0;
     flock->num_sh_active = 0;
@@ -98,7 +61,7 @@ void flock_init(struct flock_t *flock) {
     cv_init(&flock->ex_flock);
     cv_init(&flock->sh_flock);
 }
-int flock_acquire(struct flock_t *flock, int operation)
+static int flock_acquire(struct flock_t *flock, int operation)
 {
     spinlock_acquire(&flock->lock);
 
@@ -116,7 +79,6 @@ int flock_acquire(struct flock_t *flock, int operation)
             }
             dprintf("[flock] LOCK_EX denied: file is in shared use (added to wait list)\n");
             flock->num_ex_waiting++;   
-            flock->ex_flock.waiters++; 
             spinlock_release(&flock->lock);
             return EWOULDBLOCK;
         }
@@ -193,7 +155,7 @@ else if (operation & LOCK_SH)
 
 
 
-int flock_release(struct flock_t *flock)
+static int flock_release(struct flock_t *flock)
 {
     spinlock_acquire(&flock->lock);
 
@@ -481,6 +443,82 @@ int mon_flock(int argc, char **argv, struct Trapframe *tf) {
     return 0;
 }
 
+int mon_diskstat(int argc, char **argv, struct Trapframe *tf)
+{
+    static const char *dir[2] = { "read", "write" };
+    struct diskstat st;
+    uint32_t dev;
+    int rw, i;
+    int want = argc > 1 ? argv[1][0] - '0' : -1;  // one-digit device
+
+    dprintf("driver %s\n", disk_name());
+    for (dev = 0; dev < NDISKSTAT; dev++) {
+        if (want >= 0 && dev != want)
+            continue;
+        if (diskstat_get(dev, &st) < 0
+            || st.ops[0] + st.ops[1] + st.cache_hits + st.cache_misses == 0)
+            continue;
+
+        dprintf("disk %d: %u B/s, depth %u (max %u), cache hits %u%%\n",
+                dev, st.bytes_per_sec, st.depth, st.maxdepth,
+                st.cache_hit_pct);
+        for (rw = 0; rw < 2; rw++) {
+            dprintf("  %s: %llu ops, %llu bytes, avg %u us\n", dir[rw],
+                    st.ops[rw], st.bytes[rw], st.avg_us[rw]);
+            for (i = 0; i < NLATBUCKET; i++) {
+                if (st.hist[rw][i] != 0)
+                    dprintf("    %8u us: %llu\n", 1u << i, st.hist[rw][i]);
+            }
+        }
+    }
+    return 0;
+}
+
+int mon_iosched(int argc, char **argv, struct Trapframe *tf)
+{
+    struct iosched_stat st;
+    const char *name;
+    int i;
+
+    if (argc > 1 && iosched_select(argv[1]) < 0) {
+        dprintf("Unknown I/O scheduler: %s\n", argv[1]);
+        return 0;
+    }
+
+    for (i = 0; (name = iosched_stat(i, &st)) != NULL; i++) {
+        dprintf("%c %s: %llu requests, %llu merged, %llu us queued, "
+                "depth %u (max %u)\n",
+                strcmp(name, iosched_current()) == 0 ? '*' : ' ', name,
+                st.nreq, st.nmerge, diskstat_tsc_to_us(st.wait),
+                st.depth, st.maxdepth);
+    }
+    return 0;
+}
+
+int mon_ide(int argc, char **argv, struct Trapframe *tf)
+{
+    uint64_t ticks, sectors;
+    int on = -1;
+
+    if (argc > 1) {
+        if (strcmp(argv[1], "dma") == 0) {
+            on = 1;
+        } else if (strcmp(argv[1], "pio") == 0) {
+            on = 0;
+        } else {
+            dprintf("Usage: ide [pio|dma]\n");
+            return 0;
+        }
+    }
+    if (ide_dma(on) < 0 && on == 1)
+        dprintf("The IDE controller cannot do DMA.\n");
+
+    ide_stat(&ticks, &sectors);
+    dprintf("ide: %s, %llu sectors, %llu us of CPU in the driver\n",
+            ide_dma(-1) == 1 ? "DMA" : "PIO", sectors,
+            diskstat_tsc_to_us(ticks));
+    return 0;
+}
 
 // Add the test command to the commands array
 static struct Command commands[] = 
@@ -488,6 +526,10 @@ static struct Command commands[] =
     {"help", "Display this list of commands", mon_help},
     {"kerninfo", "Display information about the kernel", mon_kerninfo},
     {"flock", "Test file locking mechanism", mon_flock},
+    {"diskstat", "Display disk I/O counters [dev]", mon_diskstat},
+    {"iosched", "Display I/O scheduler counters, or switch to [name]", mon_iosched},
+    {"ide", "Display IDE driver CPU use, or switch to [pio|dma]", mon_ide},
+    {"startuser", "Start the user idle process, which runs the tests", mon_start_user},
     
 };
 
@@ -533,7 +575,7 @@ int mon_backtrace(int argc, char **argv, struct Trapframe *tf)
 int mon_start_user(int argc, char **argv, struct Trapframe *tf)
 {
     unsigned int idle_pid;
-    idle_pid = proc_create(_binary___obj_user_idle_idle_start, 10000);
+    idle_pid = proc_create(_binary___obj_user_idle_idle_start, 20000);
     KERN_DEBUG("process idle %d is created.\n", idle_pid);
 
     KERN_INFO("Start user-space ... \n");
@@ -15,6 +15,9 @@ int mon_help(int argc, char **argv, struct Trapframe *tf);
 int mon_kerninfo(int argc, char **argv, struct Trapframe *tf);
 int mon_backtrace(int argc, char **argv, struct Trapframe *tf);
 int mon_start_user(int argc, char **argv, struct Trapframe *tf);
+int mon_diskstat(int argc, char **argv, struct Trapframe *tf);
+int mon_iosched(int argc, char **argv, struct Trapframe *tf);
+int mon_ide(int argc, char **argv, struct Trapframe *tf);
 
 #endif  /* _KERN_ */
 
@@ -0,0 +1,44 @@
+#include <lib/types.h>
+#include <lib/x86.h>
+#include <lib/trap.h>
+#include <thread/PCurID/export.h>
+
+#include "spinlock.h"
+
+void spinlock_init(spinlock_t *lk)
+{
+    lk->lock_holder = NUM_IDS;
+    lk->lock = 0;
+    lk->intr = 0;
+}
+
+void spinlock_acquire(spinlock_t *lk)
+{
+    uint32_t intr = read_eflags() & FL_IF;
+
+    cli();
+    while (xchg(&lk->lock, 1) != 0)
+        pause();
+    lk->lock_holder = get_curid();
+    lk->intr = intr;
+}
+
+void spinlock_release(spinlock_t *lk)
+{
+    uint32_t intr = lk->intr;
+
+    if (spinlock_holding(lk) == FALSE)
+        return;
+
+    lk->lock_holder = NUM_IDS;
+    xchg(&lk->lock, 0);
+    // Locks are released in the reverse order they were taken, so only
+    // the outermost one turns interrupts back on.
+    if (intr)
+        sti();
+}
+
+bool spinlock_holding(spinlock_t *lk)
+{
+    return lk->lock && lk->lock_holder == get_curid();
+}
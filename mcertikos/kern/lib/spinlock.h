@@ -0,0 +1,26 @@
+#ifndef _KERN_LIB_SPINLOCK_H_
+#define _KERN_LIB_SPINLOCK_H_
+
+#ifdef _KERN_
+
+#include <lib/types.h>
+
+/**
+ * A spinlock. Interrupts stay off while it is held, so the holder is
+ * never preempted and an interrupt handler can never spin on a lock
+ * that the thread it interrupted holds.
+ */
+typedef struct {
+    volatile uint32_t lock_holder;  // thread id, NUM_IDS if free
+    volatile uint32_t lock;
+    uint32_t intr;  // whether interrupts were on before acquiring
+} spinlock_t;
+
+void spinlock_init(spinlock_t *lk);
+void spinlock_acquire(spinlock_t *lk);
+void spinlock_release(spinlock_t *lk);
+bool spinlock_holding(spinlock_t *lk);
+
+#endif  /* _KERN_ */
+
+#endif  /* !_KERN_LIB_SPINLOCK_H_ */
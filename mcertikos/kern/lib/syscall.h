@@ -37,6 +37,35 @@ enum __syscall_nr {
     SYS_yield,      /* yield to another process */
     SYS_fork,
 
+    /*
+     * file system calls (kern/fs/sysfile.c)
+     */
+    SYS_open,       /* open or create a file */
+    SYS_close,      /* close a file descriptor */
+    SYS_read,       /* read from a file */
+    SYS_write,      /* write to a file */
+    SYS_pread,      /* read from a file at a given offset */
+    SYS_pwrite,     /* write to a file at a given offset */
+    SYS_readv,      /* read from a file into several buffers */
+    SYS_writev,     /* write several buffers to a file */
+    SYS_fadvise,    /* access pattern hint for a file range */
+    SYS_fsync,      /* commit pending writes to a file */
+    SYS_fdatasync,  /* commit pending data of a file */
+    SYS_fstat,      /* get file metadata */
+    SYS_link,       /* create a hard link */
+    SYS_unlink,     /* remove a directory entry */
+    SYS_mkdir,      /* create a directory */
+    SYS_chdir,      /* change the working directory */
+    SYS_flock,      /* whole-file advisory lock */
+    SYS_fcntl,      /* byte-range record locks */
+    SYS_getdents,   /* read a batch of directory entries */
+    SYS_copy_file_range, /* copy between files inside the kernel */
+    SYS_mmap,       /* map a file into the address space */
+    SYS_munmap,     /* remove a file mapping */
+    SYS_io_setup,   /* map an I/O submission/completion ring */
+    SYS_io_enter,   /* run the requests queued on the I/O ring */
+    SYS_diskstat,   /* snapshot the I/O counters of a disk */
+
     MAX_SYSCALL_NR  /* XXX: always put it at the end of __syscall_nr */
 };
 
@@ -64,6 +93,11 @@ enum __error_nr {
     E_HVM_IOPORT,
     E_HVM_MSR,
     E_HVM_INTRWIN,
+    E_BADF,          /* bad file descriptor */
+    E_NEXIST,        /* file does not exist */
+    E_CREATE,        /* file creation failure */
+    E_AGAIN,         /* operation would block */
+    E_INVAL,         /* invalid argument */
     MAX_ERROR_NR     /* XXX: always put it at the end of __error_nr */
 };
 
@@ -0,0 +1,16 @@
+#ifndef _KERN_LIB_VM_H_
+#define _KERN_LIB_VM_H_
+
+#ifdef _KERN_
+
+/*
+ * Windows of the user address space that the kernel manages itself and
+ * that fork does not copy (see map_cow()).
+ */
+#define VM_MMAPLO 0xc0000000  /* file mappings, see kern/fs/mmap.h */
+#define VM_MMAPHI 0xe0000000
+#define VM_IORING 0xe0000000  /* the I/O ring page, see kern/fs/ioring.h */
+
+#endif  /* _KERN_ */
+
+#endif  /* !_KERN_LIB_VM_H_ */
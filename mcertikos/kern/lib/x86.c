@@ -18,6 +18,41 @@ gcc_inline void sti(void)
     __asm __volatile ("sti; nop");
 }
 
+gcc_inline uint32_t read_eflags(void)
+{
+    uint32_t eflags;
+    __asm __volatile ("pushfl; popl %0" : "=r" (eflags));
+    return eflags;
+}
+
+gcc_inline uint32_t xchg(volatile uint32_t *addr, uint32_t newval)
+{
+    uint32_t result;
+
+    __asm __volatile ("lock; xchgl %0, %1"
+                      : "+m" (*addr), "=a" (result)
+                      : "1" (newval)
+                      : "cc");
+    return result;
+}
+
+gcc_inline uint32_t cmpxchg(volatile uint32_t *addr, uint32_t oldval,
+                            uint32_t newval)
+{
+    uint32_t result;
+
+    __asm __volatile ("lock; cmpxchgl %2, %0"
+                      : "+m" (*addr), "=a" (result)
+                      : "r" (newval), "1" (oldval)
+                      : "cc");
+    return result;
+}
+
+gcc_inline void pause(void)
+{
+    __asm __volatile ("pause" ::: "memory");
+}
+
 gcc_inline uint64_t rdmsr(uint32_t msr)
 {
     uint64_t rv;
@@ -113,6 +148,18 @@ gcc_inline uint32_t inl(int port)
     return data;
 }
 
+gcc_inline void outw(int port, uint16_t data)
+{
+    __asm __volatile ("outw %0,%w1" :: "a" (data), "d" (port));
+}
+
+gcc_inline uint16_t inw(int port)
+{
+    uint16_t data;
+    __asm __volatile ("inw %w1,%0" : "=a" (data) : "d" (port));
+    return data;
+}
+
 gcc_inline void smp_wmb(void)
 {
     __asm __volatile ("" ::: "memory");
@@ -181,6 +228,14 @@ gcc_inline void outb(int port, uint8_t data)
     __asm __volatile ("outb %0,%w1" :: "a" (data), "d" (port));
 }
 
+gcc_inline void outsl(int port, const void *addr, int cnt)
+{
+    __asm __volatile ("cld\n\trepne\n\toutsl"
+                      : "=S" (addr), "=c" (cnt)
+                      : "d" (port), "0" (addr), "1" (cnt)
+                      : "cc");
+}
+
 gcc_inline void outsw(int port, const void *addr, int cnt)
 {
     __asm __volatile ("cld\n\trepne\n\toutsw"
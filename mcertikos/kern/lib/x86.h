@@ -57,6 +57,10 @@ static inline uint32_t __attribute__ ((always_inline)) read_ebp(void)
 void lldt(uint16_t sel);
 void cli(void);
 void sti(void);
+uint32_t read_eflags(void);
+uint32_t xchg(volatile uint32_t *addr, uint32_t newval);
+uint32_t cmpxchg(volatile uint32_t *addr, uint32_t oldval, uint32_t newval);
+void pause(void);
 uint64_t rdmsr(uint32_t msr);
 void wrmsr(uint32_t msr, uint64_t newval);
 void halt(void);
@@ -68,6 +72,8 @@ cpu_vendor vender(void);
 uint32_t rcr3(void);
 void outl(int port, uint32_t data);
 uint32_t inl(int port);
+void outw(int port, uint16_t data);
+uint16_t inw(int port);
 void smp_wmb(void);
 void ltr(uint16_t sel);
 void lcr0(uint32_t val);
@@ -79,6 +85,7 @@ uint32_t rcr4(void);
 uint8_t inb(int port);
 void insl(int port, void *addr, int cnt);
 void outb(int port, uint8_t data);
+void outsl(int port, const void *addr, int cnt);
 void outsw(int port, const void *addr, int cnt);
 
 #define FENCE() asm volatile ("mfence" ::: "memory")
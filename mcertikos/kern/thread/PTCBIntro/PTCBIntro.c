@@ -9,11 +9,15 @@
  * the next TCB.
  * Since the value 0 is reserved for thread id 0, we use NUM_IDS
  * to represent the NULL index.
+ * chan is what a thread in thread_sleep() is waiting on.
+ * cwd is the working directory of the process, NULL for the root.
  */
 struct TCB {
     t_state state;
     unsigned int prev;
     unsigned int next;
+    void *chan;
+    struct inode *cwd;
 };
 
 struct TCB TCBPool[NUM_IDS];
@@ -48,9 +52,31 @@ void tcb_set_next(unsigned int pid, unsigned int next_pid)
     TCBPool[pid].next = next_pid;
 }
 
+void *tcb_get_chan(unsigned int pid)
+{
+    return TCBPool[pid].chan;
+}
+
+void tcb_set_chan(unsigned int pid, void *chan)
+{
+    TCBPool[pid].chan = chan;
+}
+
+struct inode *tcb_get_cwd(unsigned int pid)
+{
+    return TCBPool[pid].cwd;
+}
+
+void tcb_set_cwd(unsigned int pid, struct inode *cwd)
+{
+    TCBPool[pid].cwd = cwd;
+}
+
 void tcb_init_at_id(unsigned int pid)
 {
     TCBPool[pid].state = TSTATE_DEAD;
     TCBPool[pid].prev = NUM_IDS;
     TCBPool[pid].next = NUM_IDS;
+    TCBPool[pid].chan = NULL;
+    TCBPool[pid].cwd = NULL;
 }
@@ -3,12 +3,18 @@
 
 #ifdef _KERN_
 
+struct inode;
+
 unsigned int tcb_get_state(unsigned int pid);
 void tcb_set_state(unsigned int pid, unsigned int state);
 unsigned int tcb_get_prev(unsigned int pid);
 void tcb_set_prev(unsigned int pid, unsigned int prev_pid);
 unsigned int tcb_get_next(unsigned int pid);
 void tcb_set_next(unsigned int pid, unsigned int next_pid);
+void *tcb_get_chan(unsigned int pid);
+void tcb_set_chan(unsigned int pid, void *chan);
+struct inode *tcb_get_cwd(unsigned int pid);
+void tcb_set_cwd(unsigned int pid, struct inode *cwd);
 void tcb_init_at_id(unsigned int pid);
 
 #endif  /* _KERN_ */
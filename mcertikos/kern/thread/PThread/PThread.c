@@ -1,5 +1,7 @@
 #include <lib/x86.h>
+#include <lib/debug.h>
 #include <lib/thread.h>
+#include <lib/spinlock.h>
 
 #include "import.h"
 
@@ -64,3 +66,83 @@ void thread_yield(void)
         kctx_switch(old_cur_pid, new_cur_pid);
     }
 }
+
+/**
+ * Put the current thread to sleep and switch to the next thread in the
+ * ready queue. The caller must already have queued the current thread
+ * wherever its waker will find it, and must have interrupts off.
+ */
+void thread_suspend(void)
+{
+    unsigned int new_cur_pid;
+    unsigned int old_cur_pid = get_curid();
+
+    tcb_set_state(old_cur_pid, TSTATE_SLEEP);
+
+    new_cur_pid = tqueue_dequeue(NUM_IDS);
+    if (new_cur_pid == NUM_IDS) {
+        KERN_PANIC("thread %d went to sleep with no thread ready.\n",
+                   old_cur_pid);
+    }
+    tcb_set_state(new_cur_pid, TSTATE_RUN);
+    set_curid(new_cur_pid);
+
+    kctx_switch(old_cur_pid, new_cur_pid);
+}
+
+/**
+ * Wake the sleeping thread pid up by pushing it to the ready queue.
+ */
+void thread_ready(unsigned int pid)
+{
+    tcb_set_state(pid, TSTATE_READY);
+    tqueue_enqueue(NUM_IDS, pid);
+}
+
+/**
+ * Queues 0 .. NUM_IDS - 1 of the pool are sleep queues; a channel
+ * hashes to one of them, and wakers match on the TCB's channel.
+ */
+#define SLEEPQ(chan) ((((uintptr_t) (chan)) >> 2) % NUM_IDS)
+
+/**
+ * Atomically release lk and sleep on chan until thread_wakeup(chan);
+ * lk is held again on return.
+ */
+void thread_sleep(void *chan, spinlock_t *lk)
+{
+    unsigned int pid = get_curid();
+    uint32_t intr = lk->intr;
+
+    tcb_set_chan(pid, chan);
+    tqueue_enqueue(SLEEPQ(chan), pid);
+
+    // Leave interrupts off across the release, so no wakeup can come
+    // between it and the switch; the next thread turns them back on.
+    lk->intr = 0;
+    spinlock_release(lk);
+    thread_suspend();
+
+    spinlock_acquire(lk);
+    lk->intr = intr;
+}
+
+/**
+ * Wake up every thread sleeping on chan.
+ */
+void thread_wakeup(void *chan)
+{
+    unsigned int chid = SLEEPQ(chan);
+    unsigned int pid = tqueue_get_head(chid);
+    unsigned int next;
+
+    while (pid != NUM_IDS) {
+        next = tcb_get_next(pid);
+        if (tcb_get_chan(pid) == chan) {
+            tqueue_remove(chid, pid);
+            tcb_set_chan(pid, NULL);
+            thread_ready(pid);
+        }
+        pid = next;
+    }
+}
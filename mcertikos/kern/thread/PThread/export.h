@@ -3,10 +3,16 @@
 
 #ifdef _KERN_
 
+#include <lib/spinlock.h>
+
 void thread_init(unsigned int mbi_addr);
 unsigned int thread_spawn(void *entry, unsigned int id,
                           unsigned int quota);
 void thread_yield(void);
+void thread_suspend(void);
+void thread_ready(unsigned int pid);
+void thread_sleep(void *chan, spinlock_t *lk);
+void thread_wakeup(void *chan);
 
 #endif  /* _KERN_ */
 
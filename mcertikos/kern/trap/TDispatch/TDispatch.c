@@ -8,6 +8,11 @@ void syscall_dispatch(void)
 
     nr = syscall_get_arg1();
 
+    // The file system is mounted by the first process that uses it,
+    // since recovering the log reads the disk and must be able to sleep.
+    if (SYS_open <= nr && nr < MAX_SYSCALL_NR)
+        fs_mount();
+
     switch (nr) {
     case SYS_puts:
         /*
@@ -59,6 +64,418 @@ void syscall_dispatch(void)
     case SYS_fork:
         sys_fork();
         break;
+    case SYS_open:
+        /*
+         * Open a file, creating it if O_CREATE is given.
+         *
+         * Parameters:
+         *   a[0]: the linear address where the path is
+         *   a[1]: the O_* open mode
+         *   a[2]: the length of the path
+         *
+         * Return:
+         *   the file descriptor
+         *
+         * Error:
+         *   E_NEXIST, E_INVAL_ADDR
+         */
+        sys_open();
+        break;
+    case SYS_close:
+        /*
+         * Close a file descriptor.
+         *
+         * Parameters:
+         *   a[0]: the file descriptor
+         *
+         * Return:
+         *   0
+         *
+         * Error:
+         *   E_BADF
+         */
+        sys_close();
+        break;
+    case SYS_read:
+        /*
+         * Read from a file at its offset.
+         *
+         * Parameters:
+         *   a[0]: the file descriptor
+         *   a[1]: the linear address of the buffer
+         *   a[2]: the length of the buffer
+         *
+         * Return:
+         *   the number of bytes read
+         *
+         * Error:
+         *   E_BADF, E_INVAL_ADDR
+         */
+        sys_read();
+        break;
+    case SYS_write:
+        /*
+         * Write to a file at its offset.
+         *
+         * Parameters:
+         *   a[0]: the file descriptor
+         *   a[1]: the linear address of the buffer
+         *   a[2]: the length of the buffer
+         *
+         * Return:
+         *   the number of bytes written
+         *
+         * Error:
+         *   E_BADF, E_INVAL_ADDR
+         */
+        sys_write();
+        break;
+    case SYS_pread:
+        /*
+         * Read from a file at the given offset, leaving its offset alone.
+         *
+         * Parameters:
+         *   a[0]: the file descriptor
+         *   a[1]: the linear address of the buffer
+         *   a[2]: the length of the buffer
+         *   a[3]: the file offset
+         *
+         * Return:
+         *   the number of bytes read
+         *
+         * Error:
+         *   E_BADF, E_INVAL_ADDR
+         */
+        sys_pread();
+        break;
+    case SYS_pwrite:
+        /*
+         * Write to a file at the given offset, leaving its offset alone.
+         *
+         * Parameters:
+         *   a[0]: the file descriptor
+         *   a[1]: the linear address of the buffer
+         *   a[2]: the length of the buffer
+         *   a[3]: the file offset
+         *
+         * Return:
+         *   the number of bytes written
+         *
+         * Error:
+         *   E_BADF, E_INVAL_ADDR
+         */
+        sys_pwrite();
+        break;
+    case SYS_readv:
+        /*
+         * Read from a file into several buffers.
+         *
+         * Parameters:
+         *   a[0]: the file descriptor
+         *   a[1]: the linear address of the struct iovec array
+         *   a[2]: the number of entries in the array
+         *
+         * Return:
+         *   the number of bytes read
+         *
+         * Error:
+         *   E_BADF, E_INVAL_ADDR
+         */
+        sys_readv();
+        break;
+    case SYS_writev:
+        /*
+         * Write several buffers to a file.
+         *
+         * Parameters:
+         *   a[0]: the file descriptor
+         *   a[1]: the linear address of the struct iovec array
+         *   a[2]: the number of entries in the array
+         *
+         * Return:
+         *   the number of bytes written
+         *
+         * Error:
+         *   E_BADF, E_INVAL_ADDR
+         */
+        sys_writev();
+        break;
+    case SYS_fadvise:
+        /*
+         * Give a hint about how a range of a file will be accessed.
+         *
+         * Parameters:
+         *   a[0]: the file descriptor
+         *   a[1]: the offset of the range
+         *   a[2]: the length of the range (0 means to the end)
+         *   a[3]: the FADV_* advice
+         *
+         * Return:
+         *   0
+         *
+         * Error:
+         *   E_BADF
+         */
+        sys_fadvise();
+        break;
+    case SYS_fsync:
+        /*
+         * Make the writes to a file durable.
+         *
+         * Parameters:
+         *   a[0]: the file descriptor
+         *
+         * Return:
+         *   0
+         *
+         * Error:
+         *   E_BADF
+         */
+        sys_fsync();
+        break;
+    case SYS_fdatasync:
+        /*
+         * Make the data written to a file durable.
+         *
+         * Parameters:
+         *   a[0]: the file descriptor
+         *
+         * Return:
+         *   0
+         *
+         * Error:
+         *   E_BADF
+         */
+        sys_fdatasync();
+        break;
+    case SYS_fstat:
+        /*
+         * Get the metadata of a file.
+         *
+         * Parameters:
+         *   a[0]: the file descriptor
+         *   a[1]: the linear address of the struct file_stat
+         *
+         * Return:
+         *   0
+         *
+         * Error:
+         *   E_BADF, E_INVAL_ADDR
+         */
+        sys_fstat();
+        break;
+    case SYS_link:
+        /*
+         * Create a new name for a file.
+         *
+         * Parameters:
+         *   a[0]: the linear address where the old path is
+         *   a[1]: the linear address where the new path is
+         *   a[2]: the length of the old path
+         *   a[3]: the length of the new path
+         *
+         * Return:
+         *   None.
+         *
+         * Error:
+         *   E_NEXIST, E_DISK_OP, E_INVAL_ADDR
+         */
+        sys_link();
+        break;
+    case SYS_unlink:
+        /*
+         * Remove a directory entry.
+         *
+         * Parameters:
+         *   a[0]: the linear address where the path is
+         *   a[1]: the length of the path
+         *
+         * Return:
+         *   None.
+         *
+         * Error:
+         *   E_DISK_OP, E_INVAL_ADDR
+         */
+        sys_unlink();
+        break;
+    case SYS_mkdir:
+        /*
+         * Create a directory.
+         *
+         * Parameters:
+         *   a[0]: the linear address where the path is
+         *   a[1]: the length of the path
+         *
+         * Return:
+         *   None.
+         *
+         * Error:
+         *   E_DISK_OP, E_INVAL_ADDR
+         */
+        sys_mkdir();
+        break;
+    case SYS_chdir:
+        /*
+         * Change the working directory of the process.
+         *
+         * Parameters:
+         *   a[0]: the linear address where the path is
+         *   a[1]: the length of the path
+         *
+         * Return:
+         *   None.
+         *
+         * Error:
+         *   E_DISK_OP, E_INVAL_ADDR
+         */
+        sys_chdir();
+        break;
+    case SYS_flock:
+        /*
+         * Take or drop a whole-file advisory lock.
+         *
+         * Parameters:
+         *   a[0]: the file descriptor
+         *   a[1]: the LOCK_* operation
+         *
+         * Return:
+         *   0
+         *
+         * Error:
+         *   E_BADF
+         */
+        sys_flock();
+        break;
+    case SYS_fcntl:
+        /*
+         * Test, take or drop a byte-range lock, or get or set the lock
+         * policy of a file.
+         *
+         * Parameters:
+         *   a[0]: the file descriptor
+         *   a[1]: the F_* command
+         *   a[2]: the linear address of the struct flock, or the policy
+         *
+         * Return:
+         *   0, or the previous policy
+         *
+         * Error:
+         *   E_BADF, E_INVAL, E_AGAIN, E_MEM, E_INVAL_ADDR
+         */
+        sys_fcntl();
+        break;
+    case SYS_getdents:
+        /*
+         * Read a batch of directory entries.
+         *
+         * Parameters:
+         *   a[0]: the file descriptor
+         *   a[1]: the linear address of the buffer
+         *   a[2]: the length of the buffer
+         *
+         * Return:
+         *   the number of bytes filled
+         *
+         * Error:
+         *   E_BADF, E_INVAL_ADDR
+         */
+        sys_getdents();
+        break;
+    case SYS_copy_file_range:
+        /*
+         * Copy between two files inside the kernel.
+         *
+         * Parameters:
+         *   a[0]: the input file descriptor
+         *   a[1]: the output file descriptor
+         *   a[2]: the number of bytes to copy
+         *
+         * Return:
+         *   the number of bytes copied
+         *
+         * Error:
+         *   E_BADF
+         */
+        sys_copy_file_range();
+        break;
+    case SYS_mmap:
+        /*
+         * Map a file read-only into the address space.
+         *
+         * Parameters:
+         *   a[0]: the file descriptor
+         *   a[1]: the length of the mapping
+         *   a[2]: the page-aligned file offset
+         *
+         * Return:
+         *   the address of the mapping
+         *
+         * Error:
+         *   E_BADF, E_INVAL_ADDR
+         */
+        sys_mmap();
+        break;
+    case SYS_munmap:
+        /*
+         * Remove a file mapping.
+         *
+         * Parameters:
+         *   a[0]: the address the mapping starts at
+         *
+         * Return:
+         *   0
+         *
+         * Error:
+         *   E_INVAL_ADDR
+         */
+        sys_munmap();
+        break;
+    case SYS_io_setup:
+        /*
+         * Map an I/O submission/completion ring.
+         *
+         * Parameters:
+         *   None.
+         *
+         * Return:
+         *   the address of the ring
+         *
+         * Error:
+         *   E_MEM
+         */
+        sys_io_setup();
+        break;
+    case SYS_io_enter:
+        /*
+         * Run the requests queued on the I/O ring.
+         *
+         * Parameters:
+         *   None.
+         *
+         * Return:
+         *   the number of requests run
+         *
+         * Error:
+         *   E_INVAL_ADDR
+         */
+        sys_io_enter();
+        break;
+    case SYS_diskstat:
+        /*
+         * Snapshot the I/O counters of a disk.
+         *
+         * Parameters:
+         *   a[0]: the device number
+         *   a[1]: the linear address of the struct diskstat
+         *
+         * Return:
+         *   0
+         *
+         * Error:
+         *   E_INVAL_ID, E_INVAL_ADDR
+         */
+        sys_diskstat();
+        break;
     default:
         syscall_set_errno(E_INVAL_CALLNR);
     }
@@ -9,6 +9,32 @@ void sys_puts(void);
 void sys_spawn(void);
 void sys_yield(void);
 void sys_fork(void);
+void sys_open(void);
+void sys_close(void);
+void sys_read(void);
+void sys_write(void);
+void sys_pread(void);
+void sys_pwrite(void);
+void sys_readv(void);
+void sys_writev(void);
+void sys_fadvise(void);
+void sys_fsync(void);
+void sys_fdatasync(void);
+void sys_fstat(void);
+void sys_link(void);
+void sys_unlink(void);
+void sys_mkdir(void);
+void sys_chdir(void);
+void sys_flock(void);
+void sys_fcntl(void);
+void sys_getdents(void);
+void sys_copy_file_range(void);
+void sys_mmap(void);
+void sys_munmap(void);
+void sys_io_setup(void);
+void sys_io_enter(void);
+void sys_diskstat(void);
+void fs_mount(void);
 
 #endif  /* _KERN_ */
 
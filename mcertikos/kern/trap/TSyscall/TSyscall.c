@@ -57,6 +57,12 @@ extern uint8_t _binary___obj_user_pingpong_ping_start[];
 extern uint8_t _binary___obj_user_pingpong_pong_start[];
 extern uint8_t _binary___obj_user_pingpong_ding_start[];
 extern uint8_t _binary___obj_user_fork_test_fork_test_start[];
+extern uint8_t _binary___obj_user_flocktest_flocktest_start[];
+extern uint8_t _binary___obj_user_flocktest_flockdemo_start[];
+extern uint8_t _binary___obj_user_flocktest_flockreader_start[];
+extern uint8_t _binary___obj_user_flocktest_flockwriter_start[];
+extern uint8_t _binary___obj_user_flocktest_flockstall_start[];
+extern uint8_t _binary___obj_user_flocktest_rangewriter_start[];
 
 /**
  * Spawns a new child process.
@@ -70,7 +76,9 @@ extern uint8_t _binary___obj_user_fork_test_fork_test_start[];
  * we statically load the ELF binaries into the memory based on the
  * first parameter [elf_id].
  * For example, ping, pong, ding and fork_test correspond to the elf_ids
- * 1, 2, 3, and 4, respectively.
+ * 1, 2, 3, and 4, respectively. The flock tests in user/flocktest/ are
+ * flocktest, flockdemo, flockreader, flockwriter, flockstall and
+ * rangewriter, with the elf_ids 6 to 11.
  * If the parameter [elf_id] is none of these, then it should return
  * NUM_IDS with the error number E_INVAL_PID. The same error case apply
  * when the proc_create fails.
@@ -96,6 +104,24 @@ void sys_spawn(void)
     case 4:
         elf_addr = _binary___obj_user_fork_test_fork_test_start;
         break;
+    case 6:
+        elf_addr = _binary___obj_user_flocktest_flocktest_start;
+        break;
+    case 7:
+        elf_addr = _binary___obj_user_flocktest_flockdemo_start;
+        break;
+    case 8:
+        elf_addr = _binary___obj_user_flocktest_flockreader_start;
+        break;
+    case 9:
+        elf_addr = _binary___obj_user_flocktest_flockwriter_start;
+        break;
+    case 10:
+        elf_addr = _binary___obj_user_flocktest_flockstall_start;
+        break;
+    case 11:
+        elf_addr = _binary___obj_user_flocktest_rangewriter_start;
+        break;
     default:
         syscall_set_errno(E_INVAL_PID);
         syscall_set_retval1(NUM_IDS);
@@ -3,7 +3,9 @@
 #include <lib/syscall.h>
 #include <lib/debug.h>
 #include <lib/x86.h>
+#include <lib/vm.h>
 #include <dev/intr.h>
+#include <dev/disk/disk.h>
 
 #include <vmm/MPTOp/export.h>
 
@@ -82,6 +84,15 @@ void pgflt_handler(void)
         return;
     }
 
+    // File mappings are filled from the page cache, never with fresh pages.
+    if (VM_MMAPLO <= fault_va && fault_va < VM_MMAPHI) {
+        if (mmap_fault(cur_pid, fault_va) != 0) {
+            KERN_PANIC("Bad file mapping access: va = 0x%08x, errno = 0x%08x.\n",
+                       fault_va, errno);
+        }
+        return;
+    }
+
     if (alloc_page(cur_pid, fault_va, PTE_W | PTE_U | PTE_P) == MagicNumber) {
         KERN_PANIC("Page allocation failed: va = 0x%08x, errno = 0x%08x.\n",
                    fault_va, errno);
@@ -110,6 +121,15 @@ static int spurious_intr_handler(void)
 
 static int timer_intr_handler(void)
 {
+    intr_eoi();
+    if (fs_tick())
+        thread_yield();  // let the flusher commit the log
+    return 0;
+}
+
+static int disk_intr_handler(void)
+{
+    disk_intr();
     intr_eoi();
     return 0;
 }
@@ -121,12 +141,19 @@ static int default_intr_handler(void)
 }
 
 /**
- * Any interrupt request other than the spurious or timer should be
+ * Any interrupt request other than the spurious, timer or disk should be
  * routed to the default interrupt handler.
  */
 void interrupt_handler(void)
 {
-    switch (uctx_pool[get_curid()].trapno) {
+    unsigned int trapno = uctx_pool[get_curid()].trapno;
+
+    if (disk_irq() >= 0 && trapno == T_IRQ0 + disk_irq()) {
+        disk_intr_handler();
+        return;
+    }
+
+    switch (trapno) {
     case IRQ_TIMER:
         timer_intr_handler();
         break;
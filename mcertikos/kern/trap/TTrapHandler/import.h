@@ -12,6 +12,9 @@ void proc_start_user(void);
 unsigned int get_ptbl_entry_by_va(unsigned int proc_index, unsigned int vaddr);
 void syscall_dispatch(void);
 void map_decow(unsigned int pid, unsigned int vaddr);
+int mmap_fault(unsigned int pid, unsigned int va);
+void thread_yield(void);
+bool fs_tick(void);
 
 #endif  /* _KERN_ */
 
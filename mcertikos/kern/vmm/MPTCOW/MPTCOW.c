@@ -1,5 +1,6 @@
 #include <lib/string.h>
 #include <lib/x86.h>
+#include <lib/vm.h>
 
 #include "import.h"
 
@@ -10,16 +11,30 @@
 #define VM_USERLO_PDE (VM_USERLO / PDIRSIZE)
 #define VM_USERHI_PDE (VM_USERHI / PDIRSIZE)
 
+/* File mappings, see kern/fs/mmap.h. They map page cache pages without
+ * COW and are tracked per process, so a child does not inherit them. */
+#define VM_MMAPLO_PDE (VM_MMAPLO / PDIRSIZE)
+#define VM_MMAPHI_PDE (VM_MMAPHI / PDIRSIZE)
+
+/* The I/O ring page shared with the kernel, see kern/fs/ioring.h. It is
+ * alone in its page table; a COW copy would detach it from the kernel. */
+#define VM_IORING_PDE (VM_IORING / PDIRSIZE)
+
 #define PT_PERM_PTU (PTE_P | PTE_W | PTE_U)
 
 #define ADDR_MASK(x) ((unsigned int) x & 0xfffff000)
 
 /* Copy memory map from 'from' to 'to' and mark the copied entries as COW.
- * N.B. Only user space mapping has to be copied. */
+ * N.B. Only user space mapping has to be copied, minus file mappings
+ * and the I/O ring. */
 void map_cow(unsigned int from, unsigned int to)
 {
     unsigned int pde;
     for (pde = VM_USERLO_PDE; pde < VM_USERHI_PDE; pde++) {
+        if (VM_MMAPLO_PDE <= pde && pde < VM_MMAPHI_PDE)
+            continue;
+        if (pde == VM_IORING_PDE)
+            continue;
         copy_pdir_entry(from, to, pde);
     }
 }
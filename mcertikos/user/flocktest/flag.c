@@ -0,0 +1,36 @@
+#include <file.h>
+#include <proc.h>
+#include <syscall.h>
+#include <types.h>
+
+#include "flag.h"
+
+void flag_post(const char *name)
+{
+    uint8_t up = 1;
+    int fd;
+
+    if ((fd = open(name, O_CREATE | O_RDWR)) < 0)
+        return;
+    sys_pwrite(fd, &up, 1, 0);
+    close(fd);
+}
+
+void flag_wait(const char *name)
+{
+    uint8_t up;
+    int fd;
+
+    while (1) {
+        if ((fd = open(name, O_RDWR)) >= 0) {
+            if (sys_pread(fd, &up, 1, 0) == 1 && up) {
+                up = 0;
+                sys_pwrite(fd, &up, 1, 0);
+                close(fd);
+                return;
+            }
+            close(fd);
+        }
+        yield();
+    }
+}
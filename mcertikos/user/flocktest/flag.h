@@ -0,0 +1,12 @@
+#ifndef _USER_FLOCKTEST_FLAG_H_
+#define _USER_FLOCKTEST_FLAG_H_
+
+/*
+ * Handshakes between the flock test processes. A flag is a one-byte
+ * file: flag_post() raises it, and flag_wait() yields until it is up
+ * and lowers it again, so each post releases exactly one wait.
+ */
+void flag_post(const char *name);
+void flag_wait(const char *name);
+
+#endif  /* !_USER_FLOCKTEST_FLAG_H_ */
@@ -5,6 +5,8 @@
 #include <file.h>
 #include <gcc.h>
 
+#include "flag.h"
+
 #define exit(...) return __VA_ARGS__
 
 char buf[8192];
@@ -18,7 +20,7 @@ int main(int argc, char *argv[])
      * This process is designed to be run in conjunction with 
      * flocktest_test_nonblocking in flocktest.c
     */
-    int fd, con;
+    int fd;
     
     printf("=====starting flockstall=====\n\n");
 
@@ -37,7 +39,7 @@ int main(int argc, char *argv[])
 
     /* signal to flocktest_test_nonblocking that this process has obtained
     an exclusive lock on flockfile */
-    produce(1);
+    flag_post("stallheld");
 
     /* write to the file */
     for (int i = 0; i < 50; i++) { // changed from 100 to 50
@@ -53,7 +55,7 @@ int main(int argc, char *argv[])
 
     /* wait until flocktest_test_nonblocking has tried to obtain
     the exclusive lock (non-blocking) */
-    con = consume();
+    flag_wait("testtried");
 
     /* release the exclusive lock */
     if (flock(fd, LOCK_UN) == -1) {
@@ -1,10 +1,13 @@
 #include <proc.h>
 #include <stdio.h>
+#include <string.h>
 #include <syscall.h>
 #include <x86.h>
 #include <file.h>
 #include <gcc.h>
 
+#include "flag.h"
+
 #define exit(...) return __VA_ARGS__
 
 char buf[8192];
@@ -158,7 +161,7 @@ void flocktest_test_close(void)
 */
 void flocktest_test_nonblocking(void)
 {
-    int fd, con;
+    int fd;
 
     /* PART 1: can obtain exclusive lock with LOCK_NB flag */
     printf("=====flocktest_test_nonblocking (part 1)=====\n");
@@ -204,13 +207,15 @@ void flocktest_test_nonblocking(void)
     /* spawn flockstall, which will hold an exclusive lock for an extended
     period of time */
     pid_t child_pid;
+    unlink("stallheld");
+    unlink("testtried");
     if ((child_pid = spawn(10, 500)) == -1) { // flockstall process
         printf("ERROR in flocktest_test_nonblocking: failed to spawn flockstall process\n");
         exit();
     }
 
     /* wait until flockstall has obtained exclusive lock on flockfile */
-    con = consume();
+    flag_wait("stallheld");
 
     /* open flockfile */
     if ((fd = open("flockfile", O_RDWR)) < 0) {
@@ -223,13 +228,13 @@ void flocktest_test_nonblocking(void)
     if ((flock_retval = flock(fd, LOCK_EX | LOCK_NB)) != -1) {
        printf("flocktest_test_nonblocking failed! value: %d\n", flock_retval); 
        close(fd);
-       produce(1);
+       flag_post("testtried");
        exit();
     }
 
     /* signal to flockstall that this process has already attempted (and failed) to 
     obtain the exclusive lock; now, flockstall can continue */
-    produce(1);
+    flag_post("testtried");
 
     close(fd);
     printf("=====flocktest_test_nonblocking (part 2) ok=====\n\n");
@@ -377,6 +382,141 @@ void flocktest_test_downgrade(void)
 }
 
 
+/**
+ * Benchmark byte-range locks against flock: two rangewriter processes
+ * rewrite disjoint records of rangefile, each timing its writes under a
+ * record lock and under a whole-file lock.
+*/
+void flocktest_bench_ranges(void)
+{
+    int fd, i;
+
+    printf("=====flocktest_bench_ranges=====\n");
+
+    /* 8 records of 512 bytes, then a claim byte per record */
+    if ((fd = open("rangefile", O_CREATE | O_RDWR)) < 0) {
+        printf("ERROR in flocktest_bench_ranges: create rangefile failed.\n");
+        exit();
+    }
+    memset(buf, 0, sizeof(buf));
+    for (i = 0; i < 8 * 512 + 8; i += 512) {
+        if (write(fd, buf, 512) != 512) {
+            printf("error: write rangefile failed\n");
+            close(fd);
+            exit();
+        }
+    }
+    close(fd);
+
+    for (i = 0; i < 2; i++) {
+        if (spawn(11, 500) == -1) { // rangewriter process
+            printf("ERROR in flocktest_bench_ranges: failed to spawn rangewriter\n");
+            exit();
+        }
+    }
+
+    printf("=====flocktest_bench_ranges started=====\n\n");
+}
+
+/*
+ * Read how many processes of the burst have counted themselves done in
+ * flockdone, and the longest wait among them into *max, under the lock
+ * on the count. flockdone holds the count in byte 0 and the longest
+ * wait, in cycles, in bytes 8 to 15.
+ */
+static int fairness_ndone(int donefd, uint64_t *max)
+{
+    struct flock fl;
+    uint8_t n = 0;
+
+    fl.l_type = F_WRLCK;
+    fl.l_whence = SEEK_SET;
+    fl.l_start = 0;
+    fl.l_len = 1;
+    if (sys_fcntl(donefd, F_SETLKW, &fl) == 0) {
+        sys_pread(donefd, &n, 1, 0);
+        sys_pread(donefd, max, sizeof(*max), 8);
+        fl.l_type = F_UNLCK;
+        sys_fcntl(donefd, F_SETLK, &fl);
+    }
+    return n;
+}
+
+/*
+ * Queue a burst of readers and writers behind an exclusive lock under
+ * each flock policy. Every flockreader and flockwriter prints how long
+ * it waited and records it in flockdone, and the longest wait of the
+ * burst, its tail latency, is printed for the policy. Each burst is
+ * over, counted in flockdone, before the next policy is tried.
+ */
+void flocktest_bench_fairness(void)
+{
+    static const int policies[] = { LOCKPOL_WRITER, LOCKPOL_READER, LOCKPOL_FIFO };
+    static const char *names[] = { "writer", "reader", "fifo" };
+    uint8_t zero[16];
+    uint64_t max;
+    int fd, donefd, i, p;
+
+    printf("=====flocktest_bench_fairness=====\n");
+
+    if ((donefd = open("flockdone", O_CREATE | O_RDWR)) < 0) {
+        printf("ERROR in flocktest_bench_fairness: create flockdone failed.\n");
+        exit();
+    }
+
+    memset(zero, 0, sizeof(zero));
+    for (p = 0; p < 3; p++) {
+        if (sys_pwrite(donefd, zero, sizeof(zero), 0) != sizeof(zero)) {
+            printf("ERROR in flocktest_bench_fairness: reset flockdone failed.\n");
+            close(donefd);
+            exit();
+        }
+        /* the file stays open, so the policy stays with it */
+        if ((fd = open("flockfile", O_RDONLY)) < 0) {
+            printf("ERROR in flocktest_bench_fairness: open flockfile failed.\n");
+            close(donefd);
+            exit();
+        }
+        if (sys_lockpolicy(fd, policies[p]) == -1) {
+            printf("ERROR in flocktest_bench_fairness: set policy failed.\n");
+            close(fd);
+            close(donefd);
+            exit();
+        }
+        printf("policy %s:\n", names[p]);
+
+        if (flock(fd, LOCK_EX) == -1) {
+            printf("ERROR in flocktest_bench_fairness: could not acquire exclusive lock!\n");
+            close(fd);
+            close(donefd);
+            exit();
+        }
+        for (i = 0; i < 6; i++) {
+            /* one writer for every two readers */
+            if (spawn(i % 3 == 0 ? 9 : 8, 250) == -1) {
+                printf("ERROR in flocktest_bench_fairness: failed to spawn\n");
+                close(fd);
+                close(donefd);
+                exit();
+            }
+        }
+        /* let the burst queue up behind us */
+        for (i = 0; i < 6; i++)
+            yield();
+        flock(fd, LOCK_UN);
+
+        /* the next round must not find this one's processes queued */
+        while (fairness_ndone(donefd, &max) < 6)
+            yield();
+        close(fd);
+        printf("policy %s: longest wait %llu cycles\n", names[p], max);
+    }
+
+    close(donefd);
+    unlink("flockdone");
+    printf("=====flocktest_bench_fairness ok=====\n\n");
+}
+
 int main(int argc, char *argv[])
 {
     printf("*******flocktests starting*******\n\n");
@@ -387,6 +527,8 @@ int main(int argc, char *argv[])
     flocktest_test_nonblocking();
     flocktest_test_upgrade();
     flocktest_test_downgrade(); 
+    flocktest_bench_ranges();
+    flocktest_bench_fairness();
 
     printf("*******end of flocktests*******\n\n");
 
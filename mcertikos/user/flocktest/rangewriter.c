@@ -0,0 +1,104 @@
+#include <proc.h>
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include <x86.h>
+#include <file.h>
+#include <gcc.h>
+
+#define exit(...) return __VA_ARGS__
+
+/* rangefile holds NREC records, then one claim byte per record */
+#define NREC    8
+#define RECSIZE 512
+#define NITER   200
+#define CLAIM   (NREC * RECSIZE)
+
+char buf[RECSIZE];
+
+static int lock_range(int fd, int type, int cmd, uint32_t start, uint32_t len)
+{
+    struct flock fl;
+
+    fl.l_type = type;
+    fl.l_whence = SEEK_SET;
+    fl.l_start = start;
+    fl.l_len = len;
+    return sys_fcntl(fd, cmd, &fl);
+}
+
+/**
+ * Benchmark: every rangewriter claims its own record and rewrites it
+ * NITER times, first under a byte-range lock on just that record and
+ * then under a whole-file flock. With several writers running, the
+ * range locks never make them wait for each other; flock serializes
+ * them.
+ */
+int main(int argc, char *argv[])
+{
+    int fd, rec, i;
+    uint64_t t0, range_cycles, flock_cycles;
+
+    printf("=====starting rangewriter=====\n\n");
+
+    if ((fd = open("rangefile", O_RDWR)) < 0) {
+        printf("ERROR in rangewriter: open rangefile failed!\n");
+        exit();
+    }
+
+    /* claim the first record whose claim byte nobody else has locked */
+    for (rec = 0; rec < NREC; rec++) {
+        if (lock_range(fd, F_WRLCK, F_SETLK, CLAIM + rec, 1) == 0)
+            break;
+    }
+    if (rec == NREC) {
+        printf("ERROR in rangewriter: no free record!\n");
+        close(fd);
+        exit();
+    }
+    memset(buf, 'a' + rec, RECSIZE);
+
+    /* disjoint byte ranges */
+    t0 = rdtsc();
+    for (i = 0; i < NITER; i++) {
+        if (lock_range(fd, F_WRLCK, F_SETLKW, rec * RECSIZE, RECSIZE) == -1) {
+            printf("ERROR in rangewriter: could not lock record %d!\n", rec);
+            close(fd);
+            exit();
+        }
+        if (sys_pwrite(fd, buf, RECSIZE, rec * RECSIZE) != RECSIZE) {
+            printf("error: write record %d failed\n", rec);
+            close(fd);
+            exit();
+        }
+        lock_range(fd, F_UNLCK, F_SETLK, rec * RECSIZE, RECSIZE);
+    }
+    range_cycles = rdtsc() - t0;
+
+    /* the same writes, serialized on the whole file */
+    t0 = rdtsc();
+    for (i = 0; i < NITER; i++) {
+        if (flock(fd, LOCK_EX) == -1) {
+            printf("ERROR in rangewriter: could not acquire exclusive lock!\n");
+            close(fd);
+            exit();
+        }
+        if (sys_pwrite(fd, buf, RECSIZE, rec * RECSIZE) != RECSIZE) {
+            printf("error: write record %d failed\n", rec);
+            close(fd);
+            exit();
+        }
+        flock(fd, LOCK_UN);
+    }
+    flock_cycles = rdtsc() - t0;
+
+    printf("rangewriter record %d: %d writes in %llu cycles with range locks, "
+           "%llu cycles with flock\n", rec, NITER, range_cycles, flock_cycles);
+
+    /* closing drops the claim and any other range locks */
+    close(fd);
+
+    printf("=====finishing rangewriter=====\n");
+
+    return 0;
+}
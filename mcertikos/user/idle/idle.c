@@ -7,7 +7,7 @@ int main(int argc, char **argv)
 {
     printf("idle\n");
 
-    pid_t ping_pid, pong_pid, ding_pid;
+    pid_t ping_pid, pong_pid, ding_pid, flocktest_pid;
 
     if ((ping_pid = spawn(1, 1000)) != -1)
         printf("ping in process %d.\n", ping_pid);
@@ -24,5 +24,10 @@ int main(int argc, char **argv)
     else
         printf("Failed to launch ding.\n");
 
+    if ((flocktest_pid = spawn(6, 8000)) != -1)
+        printf("flocktest in process %d.\n", flocktest_pid);
+    else
+        printf("Failed to launch flocktest.\n");
+
     return 0;
 }
@@ -0,0 +1,28 @@
+#ifndef _USER_DIRENT_H_
+#define _USER_DIRENT_H_
+
+#include <types.h>
+
+#define DIRSIZ 14
+
+/* On-disk directory entry, see kern/fs/dir.h */
+struct dirent {
+    uint16_t inum;
+    char name[DIRSIZ];  /* not NUL-terminated if DIRSIZ long */
+};
+
+#define NDIR       4     /* directories open at once */
+#define DIRBUF_LEN 4096  /* bytes fetched per sys_getdents */
+
+typedef struct {
+    int fd;
+    int pos;  /* offset of the next entry in buf */
+    int len;  /* valid bytes in buf */
+    char buf[DIRBUF_LEN];
+} DIR;
+
+DIR *opendir(const char *path);
+struct dirent *readdir(DIR *dir);
+int closedir(DIR *dir);
+
+#endif  /* !_USER_DIRENT_H_ */
@@ -0,0 +1,29 @@
+#ifndef _USER_DISKSTAT_H_
+#define _USER_DISKSTAT_H_
+
+#include <types.h>
+
+/* Disk I/O counters, see kern/dev/disk/diskstat.h */
+
+#define NLATBUCKET 24
+
+/*
+ * [0] is reads, [1] writes. hist[rw][i] counts requests that took
+ * 2^i to 2^(i+1) - 1 microseconds.
+ */
+struct diskstat {
+    uint64_t ops[2];
+    uint64_t bytes[2];
+    uint64_t lat_us[2];
+    uint64_t hist[2][NLATBUCKET];
+    uint64_t elapsed_us;
+    uint64_t cache_hits;
+    uint64_t cache_misses;
+    uint32_t depth;
+    uint32_t maxdepth;
+    uint32_t avg_us[2];
+    uint32_t bytes_per_sec;
+    uint32_t cache_hit_pct;
+};
+
+#endif  /* !_USER_DISKSTAT_H_ */
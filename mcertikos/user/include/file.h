@@ -0,0 +1,75 @@
+#ifndef _USER_FILE_H_
+#define _USER_FILE_H_
+
+/* open() modes, see kern/fs/fcntl.h */
+#define O_RDONLY 0x000
+#define O_WRONLY 0x001
+#define O_RDWR   0x002
+#define O_CREATE 0x200
+#define O_NOSYNC 0x400
+#define O_DIRECT 0x800
+
+/* sys_fadvise() hints, see kern/fs/fcntl.h */
+#define FADV_NORMAL     0
+#define FADV_RANDOM     1
+#define FADV_SEQUENTIAL 2
+#define FADV_WILLNEED   3
+#define FADV_DONTNEED   4
+#define FADV_NOREUSE    5
+
+/* sys_fcntl() byte-range locks, see kern/fs/fcntl.h */
+#define F_GETLK  5
+#define F_SETLK  6
+#define F_SETLKW 7
+
+/* sys_lockpolicy() policies, see kern/fs/fcntl.h */
+#define F_GETLKPOL 8
+#define F_SETLKPOL 9
+
+#define LOCKPOL_WRITER 0
+#define LOCKPOL_READER 1
+#define LOCKPOL_FIFO   2
+
+/* sys_flock() operations, see kern/flock/flock.h */
+#define LOCK_SH 0x1
+#define LOCK_EX 0x2
+#define LOCK_UN 0x4
+#define LOCK_NB 0x8
+
+#define F_RDLCK 0
+#define F_WRLCK 1
+#define F_UNLCK 2
+
+#define SEEK_SET 0
+#define SEEK_CUR 1
+#define SEEK_END 2
+
+#include <types.h>
+
+struct flock {
+    int16_t l_type;
+    int16_t l_whence;
+    int32_t l_start;
+    uint32_t l_len;    /* 0 means up to the end of the file */
+    int32_t l_pid;
+};
+
+/* One buffer of a sys_readv/sys_writev request, see kern/fs/file.h */
+struct iovec {
+    void *iov_base;
+    size_t iov_len;
+};
+
+#define IOV_MAX 16
+
+int open(const char *path, int omode);
+int close(int fd);
+int read(int fd, void *buf, size_t n);
+int write(int fd, const void *buf, size_t n);
+int link(const char *old, const char *new);
+int unlink(const char *path);
+int mkdir(const char *path);
+int chdir(const char *path);
+int flock(int fd, int op);
+
+#endif  /* !_USER_FILE_H_ */
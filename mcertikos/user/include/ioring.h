@@ -0,0 +1,81 @@
+#ifndef _USER_IORING_H_
+#define _USER_IORING_H_
+
+#include <types.h>
+
+/* I/O submission/completion ring, see kern/fs/ioring.h */
+
+#define NIOSQ 64
+#define NIOCQ 64
+
+#define IO_OP_NOP   0
+#define IO_OP_READ  1
+#define IO_OP_WRITE 2
+#define IO_OP_FSYNC 3
+#define IO_OP_OPEN  4  /* addr: path, len: strlen + 1, off: open mode */
+#define IO_OP_CLOSE 5
+
+#define IO_OFF_CUR 0xffffffff  /* use and advance the file offset */
+
+struct io_sqe {
+    uint32_t op;
+    int32_t fd;
+    uint32_t addr;
+    uint32_t len;
+    uint32_t off;
+    uint32_t user_data;
+};
+
+struct io_cqe {
+    uint32_t user_data;
+    int32_t res;  /* result, or the negated error number */
+};
+
+struct io_ring {
+    volatile uint32_t sq_head;
+    volatile uint32_t sq_tail;
+    volatile uint32_t cq_head;
+    volatile uint32_t cq_tail;
+    struct io_sqe sq[NIOSQ];
+    struct io_cqe cq[NIOCQ];
+};
+
+/*
+ * Queue a request. Returns 0, or -1 if the submission queue is full.
+ * Nothing runs until sys_io_enter().
+ */
+static gcc_inline int
+io_submit(struct io_ring *r, uint32_t op, int fd, void *addr, uint32_t len,
+          uint32_t off, uint32_t user_data)
+{
+    struct io_sqe *sqe;
+
+    if (r->sq_tail - r->sq_head >= NIOSQ)
+        return -1;
+    sqe = &r->sq[r->sq_tail % NIOSQ];
+    sqe->op = op;
+    sqe->fd = fd;
+    sqe->addr = (uint32_t) addr;
+    sqe->len = len;
+    sqe->off = off;
+    sqe->user_data = user_data;
+    asm volatile ("" ::: "memory");
+    r->sq_tail++;
+    return 0;
+}
+
+/*
+ * Take the oldest completion. Returns 0, or -1 if there is none.
+ */
+static gcc_inline int
+io_reap(struct io_ring *r, struct io_cqe *cqe)
+{
+    if (r->cq_head == r->cq_tail)
+        return -1;
+    asm volatile ("" ::: "memory");
+    *cqe = r->cq[r->cq_head % NIOCQ];
+    r->cq_head++;
+    return 0;
+}
+
+#endif  /* !_USER_IORING_H_ */
@@ -4,8 +4,11 @@
 #include <lib/syscall.h>
 
 #include <debug.h>
+#include <diskstat.h>
+#include <file.h>
 #include <gcc.h>
 #include <proc.h>
+#include <string.h>
 #include <types.h>
 #include <x86.h>
 
@@ -57,4 +60,415 @@ static gcc_inline pid_t sys_fork(void)
     return pid;
 }
 
+static gcc_inline int sys_open(const char *path, int omode)
+{
+    int errno;
+    int fd;
+
+    asm volatile ("int %2"
+                  : "=a" (errno), "=b" (fd)
+                  : "i" (T_SYSCALL),
+                    "a" (SYS_open),
+                    "b" (path),
+                    "c" (omode),
+                    "d" (strlen(path) + 1)
+                  : "cc", "memory");
+
+    return errno ? -1 : fd;
+}
+
+static gcc_inline int sys_close(int fd)
+{
+    int errno;
+    int ret;
+
+    asm volatile ("int %2"
+                  : "=a" (errno), "=b" (ret)
+                  : "i" (T_SYSCALL),
+                    "a" (SYS_close),
+                    "b" (fd)
+                  : "cc", "memory");
+
+    return errno ? -1 : 0;
+}
+
+static gcc_inline int sys_read(int fd, void *buf, size_t n)
+{
+    int errno;
+    int ret;
+
+    asm volatile ("int %2"
+                  : "=a" (errno), "=b" (ret)
+                  : "i" (T_SYSCALL),
+                    "a" (SYS_read),
+                    "b" (fd),
+                    "c" (buf),
+                    "d" (n)
+                  : "cc", "memory");
+
+    return errno ? -1 : ret;
+}
+
+static gcc_inline int sys_write(int fd, const void *buf, size_t n)
+{
+    int errno;
+    int ret;
+
+    asm volatile ("int %2"
+                  : "=a" (errno), "=b" (ret)
+                  : "i" (T_SYSCALL),
+                    "a" (SYS_write),
+                    "b" (fd),
+                    "c" (buf),
+                    "d" (n)
+                  : "cc", "memory");
+
+    return errno ? -1 : ret;
+}
+
+static gcc_inline int sys_pread(int fd, void *buf, size_t n, uint32_t off)
+{
+    int errno;
+    int ret;
+
+    asm volatile ("int %2"
+                  : "=a" (errno), "=b" (ret)
+                  : "i" (T_SYSCALL),
+                    "a" (SYS_pread),
+                    "b" (fd),
+                    "c" (buf),
+                    "d" (n),
+                    "S" (off)
+                  : "cc", "memory");
+
+    return errno ? -1 : ret;
+}
+
+static gcc_inline int sys_pwrite(int fd, const void *buf, size_t n, uint32_t off)
+{
+    int errno;
+    int ret;
+
+    asm volatile ("int %2"
+                  : "=a" (errno), "=b" (ret)
+                  : "i" (T_SYSCALL),
+                    "a" (SYS_pwrite),
+                    "b" (fd),
+                    "c" (buf),
+                    "d" (n),
+                    "S" (off)
+                  : "cc", "memory");
+
+    return errno ? -1 : ret;
+}
+
+static gcc_inline int sys_readv(int fd, const struct iovec *iov, int iovcnt)
+{
+    int errno;
+    int ret;
+
+    asm volatile ("int %2"
+                  : "=a" (errno), "=b" (ret)
+                  : "i" (T_SYSCALL),
+                    "a" (SYS_readv),
+                    "b" (fd),
+                    "c" (iov),
+                    "d" (iovcnt)
+                  : "cc", "memory");
+
+    return errno ? -1 : ret;
+}
+
+static gcc_inline int sys_writev(int fd, const struct iovec *iov, int iovcnt)
+{
+    int errno;
+    int ret;
+
+    asm volatile ("int %2"
+                  : "=a" (errno), "=b" (ret)
+                  : "i" (T_SYSCALL),
+                    "a" (SYS_writev),
+                    "b" (fd),
+                    "c" (iov),
+                    "d" (iovcnt)
+                  : "cc", "memory");
+
+    return errno ? -1 : ret;
+}
+
+static gcc_inline int sys_fadvise(int fd, unsigned int off, size_t len,
+                                  int advice)
+{
+    int errno;
+    int ret;
+
+    asm volatile ("int %2"
+                  : "=a" (errno), "=b" (ret)
+                  : "i" (T_SYSCALL),
+                    "a" (SYS_fadvise),
+                    "b" (fd),
+                    "c" (off),
+                    "d" (len),
+                    "S" (advice)
+                  : "cc", "memory");
+
+    return errno ? -1 : ret;
+}
+
+static gcc_inline int sys_fsync(int fd)
+{
+    int errno;
+    int ret;
+
+    asm volatile ("int %2"
+                  : "=a" (errno), "=b" (ret)
+                  : "i" (T_SYSCALL),
+                    "a" (SYS_fsync),
+                    "b" (fd)
+                  : "cc", "memory");
+
+    return errno ? -1 : ret;
+}
+
+static gcc_inline int sys_fdatasync(int fd)
+{
+    int errno;
+    int ret;
+
+    asm volatile ("int %2"
+                  : "=a" (errno), "=b" (ret)
+                  : "i" (T_SYSCALL),
+                    "a" (SYS_fdatasync),
+                    "b" (fd)
+                  : "cc", "memory");
+
+    return errno ? -1 : ret;
+}
+
+static gcc_inline int sys_getdents(int fd, void *buf, size_t n)
+{
+    int errno;
+    int ret;
+
+    asm volatile ("int %2"
+                  : "=a" (errno), "=b" (ret)
+                  : "i" (T_SYSCALL),
+                    "a" (SYS_getdents),
+                    "b" (fd),
+                    "c" (buf),
+                    "d" (n)
+                  : "cc", "memory");
+
+    return errno ? -1 : ret;
+}
+
+static gcc_inline int sys_copy_file_range(int fd_in, int fd_out, size_t len)
+{
+    int errno;
+    int ret;
+
+    asm volatile ("int %2"
+                  : "=a" (errno), "=b" (ret)
+                  : "i" (T_SYSCALL),
+                    "a" (SYS_copy_file_range),
+                    "b" (fd_in),
+                    "c" (fd_out),
+                    "d" (len)
+                  : "cc", "memory");
+
+    return errno ? -1 : ret;
+}
+
+static gcc_inline void *sys_mmap(int fd, size_t len, unsigned int off)
+{
+    int errno;
+    unsigned int ret;
+
+    asm volatile ("int %2"
+                  : "=a" (errno), "=b" (ret)
+                  : "i" (T_SYSCALL),
+                    "a" (SYS_mmap),
+                    "b" (fd),
+                    "c" (len),
+                    "d" (off)
+                  : "cc", "memory");
+
+    return errno ? NULL : (void *) ret;
+}
+
+static gcc_inline int sys_munmap(void *va)
+{
+    int errno;
+    int ret;
+
+    asm volatile ("int %2"
+                  : "=a" (errno), "=b" (ret)
+                  : "i" (T_SYSCALL),
+                    "a" (SYS_munmap),
+                    "b" (va)
+                  : "cc", "memory");
+
+    return errno ? -1 : ret;
+}
+
+static gcc_inline void *sys_io_setup(void)
+{
+    int errno;
+    unsigned int ret;
+
+    asm volatile ("int %2"
+                  : "=a" (errno), "=b" (ret)
+                  : "i" (T_SYSCALL),
+                    "a" (SYS_io_setup)
+                  : "cc", "memory");
+
+    return errno ? NULL : (void *) ret;
+}
+
+static gcc_inline int sys_io_enter(void)
+{
+    int errno;
+    int ret;
+
+    asm volatile ("int %2"
+                  : "=a" (errno), "=b" (ret)
+                  : "i" (T_SYSCALL),
+                    "a" (SYS_io_enter)
+                  : "cc", "memory");
+
+    return errno ? -1 : ret;
+}
+
+static gcc_inline int sys_link(const char *old, const char *new)
+{
+    int errno;
+    int ret;
+
+    asm volatile ("int %2"
+                  : "=a" (errno), "=b" (ret)
+                  : "i" (T_SYSCALL),
+                    "a" (SYS_link),
+                    "b" (old),
+                    "c" (new),
+                    "d" (strlen(old) + 1),
+                    "S" (strlen(new) + 1)
+                  : "cc", "memory");
+
+    return errno ? -1 : 0;
+}
+
+static gcc_inline int sys_unlink(const char *path)
+{
+    int errno;
+    int ret;
+
+    asm volatile ("int %2"
+                  : "=a" (errno), "=b" (ret)
+                  : "i" (T_SYSCALL),
+                    "a" (SYS_unlink),
+                    "b" (path),
+                    "c" (strlen(path) + 1)
+                  : "cc", "memory");
+
+    return errno ? -1 : 0;
+}
+
+static gcc_inline int sys_mkdir(const char *path)
+{
+    int errno;
+    int ret;
+
+    asm volatile ("int %2"
+                  : "=a" (errno), "=b" (ret)
+                  : "i" (T_SYSCALL),
+                    "a" (SYS_mkdir),
+                    "b" (path),
+                    "c" (strlen(path) + 1)
+                  : "cc", "memory");
+
+    return errno ? -1 : 0;
+}
+
+static gcc_inline int sys_chdir(const char *path)
+{
+    int errno;
+    int ret;
+
+    asm volatile ("int %2"
+                  : "=a" (errno), "=b" (ret)
+                  : "i" (T_SYSCALL),
+                    "a" (SYS_chdir),
+                    "b" (path),
+                    "c" (strlen(path) + 1)
+                  : "cc", "memory");
+
+    return errno ? -1 : 0;
+}
+
+static gcc_inline int sys_flock(int fd, int op)
+{
+    int errno;
+    int ret;
+
+    asm volatile ("int %2"
+                  : "=a" (errno), "=b" (ret)
+                  : "i" (T_SYSCALL),
+                    "a" (SYS_flock),
+                    "b" (fd),
+                    "c" (op)
+                  : "cc", "memory");
+
+    return errno ? -1 : ret;
+}
+
+static gcc_inline int sys_fcntl(int fd, int cmd, struct flock *fl)
+{
+    int errno;
+    int ret;
+
+    asm volatile ("int %2"
+                  : "=a" (errno), "=b" (ret)
+                  : "i" (T_SYSCALL),
+                    "a" (SYS_fcntl),
+                    "b" (fd),
+                    "c" (cmd),
+                    "d" (fl)
+                  : "cc", "memory");
+
+    return errno ? -1 : ret;
+}
+
+static gcc_inline int sys_lockpolicy(int fd, int policy)
+{
+    int errno;
+    int ret;
+
+    asm volatile ("int %2"
+                  : "=a" (errno), "=b" (ret)
+                  : "i" (T_SYSCALL),
+                    "a" (SYS_fcntl),
+                    "b" (fd),
+                    "c" (policy == -1 ? F_GETLKPOL : F_SETLKPOL),
+                    "d" (policy)
+                  : "cc", "memory");
+
+    return errno ? -1 : ret;
+}
+
+static gcc_inline int sys_diskstat(unsigned int dev, struct diskstat *st)
+{
+    int errno;
+    int ret;
+
+    asm volatile ("int %2"
+                  : "=a" (errno), "=b" (ret)
+                  : "i" (T_SYSCALL),
+                    "a" (SYS_diskstat),
+                    "b" (dev),
+                    "c" (st)
+                  : "cc", "memory");
+
+    return errno ? -1 : ret;
+}
+
 #endif  /* !_USER_SYSCALL_H_ */
@@ -0,0 +1,57 @@
+#include <dirent.h>
+#include <file.h>
+#include <syscall.h>
+#include <types.h>
+
+static DIR dirs[NDIR];
+static bool dir_used[NDIR];
+
+DIR *opendir(const char *path)
+{
+    int i, fd;
+
+    for (i = 0; i < NDIR; i++) {
+        if (!dir_used[i])
+            break;
+    }
+    if (i == NDIR)
+        return NULL;
+
+    if ((fd = sys_open(path, O_RDONLY)) < 0)
+        return NULL;
+
+    dir_used[i] = TRUE;
+    dirs[i].fd = fd;
+    dirs[i].pos = 0;
+    dirs[i].len = 0;
+    return &dirs[i];
+}
+
+/**
+ * Return the next entry of the directory, refilling the buffer with
+ * one sys_getdents call whenever it runs dry.
+ * Return NULL at the end of the directory or on error.
+ */
+struct dirent *readdir(DIR *dir)
+{
+    struct dirent *de;
+
+    if (dir->pos >= dir->len) {
+        dir->len = sys_getdents(dir->fd, dir->buf, DIRBUF_LEN);
+        dir->pos = 0;
+        if (dir->len <= 0)
+            return NULL;
+    }
+
+    de = (struct dirent *) (dir->buf + dir->pos);
+    dir->pos += sizeof(struct dirent);
+    return de;
+}
+
+int closedir(DIR *dir)
+{
+    int fd = dir->fd;
+
+    dir_used[dir - dirs] = FALSE;
+    return sys_close(fd);
+}
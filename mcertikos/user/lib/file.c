@@ -0,0 +1,48 @@
+#include <file.h>
+#include <syscall.h>
+#include <types.h>
+
+int open(const char *path, int omode)
+{
+    return sys_open(path, omode);
+}
+
+int close(int fd)
+{
+    return sys_close(fd);
+}
+
+int read(int fd, void *buf, size_t n)
+{
+    return sys_read(fd, buf, n);
+}
+
+int write(int fd, const void *buf, size_t n)
+{
+    return sys_write(fd, buf, n);
+}
+
+int link(const char *old, const char *new)
+{
+    return sys_link(old, new);
+}
+
+int unlink(const char *path)
+{
+    return sys_unlink(path);
+}
+
+int mkdir(const char *path)
+{
+    return sys_mkdir(path);
+}
+
+int chdir(const char *path)
+{
+    return sys_chdir(path);
+}
+
+int flock(int fd, int op)
+{
+    return sys_flock(fd, op);
+}